@@ -51,12 +51,20 @@ parser.add_argument('--O3', '--o3', action='store_true',
 parser.add_argument('--disable-static-library', action='store_true',
                     help='don\'t build hash.a')
 parser.add_argument('--disable-tool', action='append', default=[],
-                    choices=[],
+                    choices=['test', 'reuse-test', 'save-test', 'save-c-test',
+                             'insert-test', 'handle-test', 'create-test',
+                             'inputs-test', 'threads-test', 'builder-test',
+                             'batch-test', 'hash-generate', 'lookup-bench',
+                             'construction-bench'],
                     help='don\'t build a specific tool')
 parser.add_argument('--enable-hash-statistics', action='store_true',
                     help='compile with -DHASH_STATISTICS')
 parser.add_argument('--disable-hash-warnings', action='store_true',
                     help='compile with -DHASH_NO_WARNINGS')
+parser.add_argument('--disable-threads', action='store_true',
+                    help='compile with -DHASH_NO_THREADS and without -pthread')
+parser.add_argument('--disable-simd', action='store_true',
+                    help='compile with -DHASH_NO_SIMD')
 #parser.add_argument('--disable-argp', action='store_true',
 #                    help='fall back to getopt for argument parsing')
 parser.add_argument('--disable-sanitize', action='store_true',
@@ -108,6 +116,13 @@ def enable_hash_statistics():
 def disable_hash_warnings():
     w.variable(key = 'defines', value = '$defines -DHASH_NO_WARNINGS')
 
+def disable_threads():
+    w.variable(key = 'defines', value = '$defines -DHASH_NO_THREADS')
+    w.variable(key = 'threadflags', value = '')
+
+def disable_simd():
+    w.variable(key = 'defines', value = '$defines -DHASH_NO_SIMD')
+
 
 #
 # THE WRITER
@@ -207,6 +222,12 @@ elif args.disable_sanitize:
 else:
     w.variable(key = 'sanflags', value = '-fsanitize=address,undefined')
 
+#
+# THREADS
+#
+
+w.variable(key = 'threadflags', value = '-pthread')
+
 #
 # INCLUDES
 #
@@ -253,6 +274,22 @@ if args.disable_hash_warnings:
     disable_hash_warnings()
     w.newline()
 
+#
+# -DHASH_NO_THREADS
+#
+if args.disable_threads:
+    w.comment('we were generated with --disable-threads, so do so')
+    disable_threads()
+    w.newline()
+
+#
+# -DHASH_NO_SIMD
+#
+if args.disable_simd:
+    w.comment('we were generated with --disable-simd, so do so')
+    disable_simd()
+    w.newline()
+
 #
 # CFLAGS/LDFLAGS OVERRIDES
 #
@@ -294,7 +331,7 @@ w.rule(
         deps = 'gcc',
         depfile = '$out.d',
         command = '$cc $std $includes -MMD -MF $out.d $defines ' +
-                  '$cflags $in -c -o $out'
+                  '$cflags $threadflags $in -c -o $out'
     )
 w.newline()
 
@@ -303,7 +340,7 @@ w.rule(
         deps = 'gcc',
         depfile = '$out.d',
         command = '$cc $std $includes -MMD -MF $out.d $defines ' +
-                  '$cflags $in -o $out $ldflags $libs'
+                  '$cflags $threadflags $in -o $out $ldflags $libs'
     )
 w.newline()
 
@@ -313,6 +350,12 @@ w.rule(
     )
 w.newline()
 
+w.rule(
+        name = 'generate',
+        command = '$in $out'
+    )
+w.newline()
+
 #
 # SOURCES
 #
@@ -320,6 +363,27 @@ w.newline()
 w.build('$builddir/hash.o', 'cc', 'src/hash.c')
 w.build('$builddir/test/test.o', 'cc', 'src/test/test.c')
 w.build('$builddir/test/reuse_test.o', 'cc', 'src/test/reuse_test.c')
+w.build('$builddir/test/save_test.o', 'cc', 'src/test/save_test.c')
+w.build('$builddir/test/save_c_test_generate.o', 'cc',
+        'src/test/save_c_test.c',
+        variables=[('defines', '$defines -DSAVE_C_TEST_GENERATE')])
+w.build('$builddir/test/save_c_test.o', 'cc', 'src/test/save_c_test.c',
+        implicit=['$builddir/test/save_c_test_salted.h',
+                  '$builddir/test/save_c_test_fingerprint.h'],
+        variables=[('includes', '$includes -I$builddir/test')])
+w.build('$builddir/test/insert_test.o', 'cc', 'src/test/insert_test.c')
+w.build('$builddir/test/handle_test.o', 'cc', 'src/test/handle_test.c')
+w.build('$builddir/test/create_test.o', 'cc', 'src/test/create_test.c')
+w.build('$builddir/test/inputs_test.o', 'cc', 'src/test/inputs_test.c')
+w.build('$builddir/test/threads_test.o', 'cc', 'src/test/threads_test.c')
+w.build('$builddir/test/builder_test.o', 'cc', 'src/test/builder_test.c')
+w.build('$builddir/test/batch_test.o', 'cc', 'src/test/batch_test.c')
+w.build('$builddir/tools/hash_generate.o', 'cc', 'src/tools/hash_generate.c')
+w.build('$builddir/bench/lookup_bench.o', 'cc', 'src/bench/lookup_bench.c')
+w.build('$builddir/bench/construction_bench.o', 'cc',
+        'src/bench/construction_bench.c')
+w.build('$builddir/bench/hash-statistics.o', 'cc', 'src/hash.c',
+        variables=[('defines', '$defines -DHASH_STATISTICS')])
 
 w.newline()
 
@@ -383,6 +447,201 @@ target(
         targets = [all_targets, tools_targets]
     )
 
+target(
+        name = 'save_test',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/test/save_test.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = 'save-test' in args.disable_tool,
+        why_disabled = 'we were generated with --disable-tool=save-test',
+        targets = [all_targets, tools_targets]
+    )
+
+save_c_test_is_disabled = [
+        'save-c-test' in args.disable_tool,
+        args.build == 'w64'
+    ]
+save_c_test_why_disabled = [
+        'we were generated with --disable-tool=save-c-test',
+        'it runs a program it builds, which a w64 build can\'t'
+    ]
+
+target(
+        name = '$builddir/test/save_c_test_generate',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/test/save_c_test_generate.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = save_c_test_is_disabled,
+        why_disabled = save_c_test_why_disabled
+    )
+
+if True not in save_c_test_is_disabled:
+    w.build(
+            [
+                '$builddir/test/save_c_test_salted.h',
+                '$builddir/test/save_c_test_fingerprint.h'
+            ],
+            'generate',
+            '$builddir/test/save_c_test_generate'
+        )
+    w.newline()
+
+target(
+        name = 'save_c_test',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/test/save_c_test.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = save_c_test_is_disabled,
+        why_disabled = save_c_test_why_disabled,
+        targets = [all_targets, tools_targets]
+    )
+
+target(
+        name = 'insert_test',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/test/insert_test.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = 'insert-test' in args.disable_tool,
+        why_disabled = 'we were generated with --disable-tool=insert-test',
+        targets = [all_targets, tools_targets]
+    )
+
+target(
+        name = 'handle_test',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/test/handle_test.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = [
+            'handle-test' in args.disable_tool,
+            args.disable_threads
+        ],
+        why_disabled = [
+            'we were generated with --disable-tool=handle-test',
+            'it needs threads and we were generated with --disable-threads'
+        ],
+        targets = [all_targets, tools_targets]
+    )
+
+target(
+        name = 'create_test',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/test/create_test.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = 'create-test' in args.disable_tool,
+        why_disabled = 'we were generated with --disable-tool=create-test',
+        targets = [all_targets, tools_targets]
+    )
+
+target(
+        name = 'inputs_test',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/test/inputs_test.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = 'inputs-test' in args.disable_tool,
+        why_disabled = 'we were generated with --disable-tool=inputs-test',
+        targets = [all_targets, tools_targets]
+    )
+
+target(
+        name = 'threads_test',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/test/threads_test.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = 'threads-test' in args.disable_tool,
+        why_disabled = 'we were generated with --disable-tool=threads-test',
+        targets = [all_targets, tools_targets]
+    )
+
+target(
+        name = 'builder_test',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/test/builder_test.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = 'builder-test' in args.disable_tool,
+        why_disabled = 'we were generated with --disable-tool=builder-test',
+        targets = [all_targets, tools_targets]
+    )
+
+target(
+        name = 'batch_test',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/test/batch_test.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = 'batch-test' in args.disable_tool,
+        why_disabled = 'we were generated with --disable-tool=batch-test',
+        targets = [all_targets, tools_targets]
+    )
+
+target(
+        name = 'hash_generate',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/tools/hash_generate.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = 'hash-generate' in args.disable_tool,
+        why_disabled = 'we were generated with --disable-tool=hash-generate',
+        targets = [all_targets, tools_targets]
+    )
+
+target(
+        name = 'lookup_bench',
+        inputs = [
+            '$builddir/hash.o',
+            '$builddir/bench/lookup_bench.o'
+        ],
+        variables = [('libs', '-lm')],
+        is_disabled = [
+            'lookup-bench' in args.disable_tool,
+            args.disable_threads,
+            args.build == 'w64'
+        ],
+        why_disabled = [
+            'we were generated with --disable-tool=lookup-bench',
+            'it needs threads and we were generated with --disable-threads',
+            'it uses pthread barriers and sysconf, which w64 builds lack'
+        ],
+        targets = [all_targets, tools_targets]
+    )
+
+target(
+        name = 'construction_bench',
+        inputs = [
+            '$builddir/bench/hash-statistics.o',
+            '$builddir/bench/construction_bench.o'
+        ],
+        variables = [('libs', '')],
+        is_disabled = [
+            'construction-bench' in args.disable_tool,
+            args.build == 'w64'
+        ],
+        why_disabled = [
+            'we were generated with --disable-tool=construction-bench',
+            'it uses fork and getrusage, which w64 builds lack'
+        ],
+        targets = [all_targets, tools_targets]
+    )
+
 target(
         rule = 'static-library',
         name = 'hash.a',
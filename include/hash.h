@@ -20,7 +20,9 @@
 #ifndef HASH_H
 #define HASH_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /* this is a hashing library
  *
@@ -40,14 +42,11 @@
  */
 
 /*
- * there is a hard limit for number of keys, around 2^39 if ssize_t can hold
- * a 63-bit number and hash_iterations_growth_multiplier is 1024. (See hash.c
- * for this.) The library will crash because it has run out of memory before
- * this point, though.
- *
- * also, if you are really using more than 2^31 keys, update salt generation
- * in hash_function_hash (in hash.c) to get more than an int's worth of random
- * data at a time for those cases.
+ * there is a hard limit for number of keys, a little under 2^31, because
+ * vertices in the graph are indexed with 32 bits and there are at least 2.09
+ * of them per key. (See hash.c for this.) hash_create() returns NULL past
+ * that point, and will stop growing the graph early for anything over about
+ * 2^28 keys.
  */
 
 /* a hash table */
@@ -56,6 +55,15 @@ struct hash;
 /* a list of keys to create a hash_table with */
 struct hash_inputs;
 
+/* a hash that can be replaced while other threads read it */
+struct hash_handle;
+
+/* one thread's way of reading through a hash_handle */
+struct hash_reader;
+
+/* scratch memory for building hash tables, kept from one build to the next */
+struct hash_builder;
+
 /* the result of a hash_lookup() */
 struct hash_lookup_result {
     const char * key; /* the key, null terminated */
@@ -65,14 +73,18 @@ struct hash_lookup_result {
 
 /* calculate a hash table for all the elements in hash_inputs
  *
- * this can fail. if it does, this function returns null.
+ * this can fail. if it does, this function returns null. it fails quickly if
+ * the same key was added twice. to find out why it failed (and, for a key
+ * added twice, the indices of both copies), use hash_create_ex() with
+ * hash_create_options.status set.
  *
- * the tuning parameters in src/hash.c can be adjusted if necessary to change
- * how the parameter-space is searched before giving up.
+ * to change how the parameter-space is searched before giving up, see the
+ * tuning options of hash_create_ex() (struct hash_create_options).
  *
- * calculation depends on the rand() function for randomness and so affects
- * that state and can be affected by seeding with srand(). it does not call
- * srand().
+ * calculation is deterministic: it draws from its own random number generator
+ * (not rand()) seeded with 0, so the same keys added in the same order give
+ * the same hash table every time, on every platform. see hash_create_ex() to
+ * use another seed.
  *
  * if this returns non-null, the keys will have been removed from hash_inputs.
  * it still needs to be free'd.
@@ -83,10 +95,206 @@ struct hash_lookup_result {
 [[nodiscard]] struct hash * hash_create(
         struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]];
 
+/* how hash_create_ex() turns a key into two vertices of the graph */
+enum hash_create_mode {
+    /* each function is a sum of every byte of the key multiplied by its own
+     * salt, which is drawn anew for every attempt. every attempt re-reads
+     * every byte of every key, and the salt is as long as the longest key
+     * (and kept by the hash table, at 4 bytes per byte of that key for each
+     * function.)
+     *
+     * on x86-64 the sums use SSE4.1, AVX2, or AVX-512 if the CPU running
+     * them has it (checked once, at the first use) unless hash.c was
+     * compiled with HASH_NO_SIMD. the results are the same either way.
+     */
+    HASH_CREATE_SALTED = 0,
+
+    /* each key is hashed once, up front, into a 64 bit fingerprint (which
+     * hash_inputs keeps for later calls.) each attempt draws a 64 bit seed
+     * per function and remixes the fingerprint with it, so an attempt costs
+     * the same no matter how long the keys are, and there is no salt: the
+     * hash table's functions take the same small, fixed space for any keys.
+     * lookups fingerprint the key the same way.
+     */
+    HASH_CREATE_FINGERPRINT
+};
+
+/* how the hash table stores the value it keeps for each vertex of the graph
+ * (a little over two per key), each of which needs as many bits as the number
+ * of vertices does
+ */
+enum hash_values_layout {
+    /* 16 bits each if that's enough and 32 otherwise */
+    HASH_VALUES_NARROWEST = 0,
+
+    /* exactly as many bits each as needed, packed end to end. smaller, at
+     * the cost of a few shifts and masks per lookup.
+     */
+    HASH_VALUES_PACKED
+};
+
+/* what became of a call to hash_create_ex(), for
+ * hash_create_options.status
+ */
+enum hash_create_outcome {
+    /* it returned a hash table */
+    HASH_CREATE_SUCCEEDED = 0,
+
+    /* the hash_inputs had no keys */
+    HASH_CREATE_FAILED_NO_KEYS,
+
+    /* an option had a value it can't take (tag_bits that isn't 0, 8, 16, or
+     * 32, or a growth multiplier that doesn't grow the graph)
+     */
+    HASH_CREATE_FAILED_BAD_OPTIONS,
+
+    /* there were too many keys to index the graph with */
+    HASH_CREATE_FAILED_TOO_MANY_KEYS,
+
+    /* the same key was added twice (see hash_create_status.duplicates) */
+    HASH_CREATE_FAILED_DUPLICATE_KEYS,
+
+    /* the graph reached iterations_max_multiplier vertices per key without
+     * a solution
+     */
+    HASH_CREATE_FAILED_NO_SOLUTION
+};
+
+/* filled by hash_create_ex() through hash_create_options.status */
+struct hash_create_status {
+    enum hash_create_outcome outcome; /* see enum hash_create_outcome */
+
+    /* for HASH_CREATE_FAILED_DUPLICATE_KEYS, the indices (the order they were
+     * added to the hash_inputs in, counting from 0) of the first copy of the
+     * key and of the copy that was found with it, in that order
+     */
+    size_t duplicates[2];
+
+    size_t attempts; /* how many attempts the search made */
+};
+
+/* options for hash_create_ex()
+ *
+ * a zero-initialized struct hash_create_options behaves the same as
+ * hash_create()
+ */
+struct hash_create_options {
+    size_t n_threads; /* how many threads to search on at once (0 means 1) */
+    enum hash_create_mode mode; /* see enum hash_create_mode */
+    uint64_t seed; /* the seed for the random number generator */
+    enum hash_values_layout values_layout; /* see enum hash_values_layout */
+
+    /* if not 0, keep a tag of this many bits (8, 16, or 32) for each key,
+     * taken from a 64 bit fingerprint of it, and check it before comparing
+     * keys. a lookup for a key that isn't in the hash table then only reads
+     * the key it would have been about once in 2^tag_bits times, at the cost
+     * of tag_bits / 8 bytes per key. (with HASH_CREATE_SALTED, each lookup
+     * also fingerprints the key.)
+     */
+    unsigned int tag_bits;
+
+    /* if true, keep no keys (or ptrs): the hash table is just the hash
+     * functions, the values, and the tags, if any. hash_lookup_index() and
+     * hash_lookup_index_unchecked() still work, but without the keys the
+     * former can only reject a key by its tag, and hash_lookup() always
+     * returns NULL. hash_get_keys(), hash_apply(), hash_recycle_inputs(),
+     * and hash_inputs_from_hash() see no keys.
+     */
+    bool drop_keys;
+
+    /* if not NULL, this is filled in with what became of the call, whether
+     * it succeeded or not, so that a caller can tell why it failed (which,
+     * with HASH_NO_WARNINGS, nothing else says.) it is only written during
+     * the call: the hash table doesn't keep it, so hash_get_options()
+     * reports NULL, and hash_rebuild() and the like don't write to it.
+     */
+    struct hash_create_status * status;
+
+    /* the rest tune the search and hash_insert. each is 0 for its default,
+     * the constant of the same name in the TUNING VALUES of src/hash.c
+     * (where they're explained), and hash_get_options() reports the values
+     * that were used.
+     */
+
+    /* the graph starts with multiplier / divider vertices per key (2.09) */
+    size_t vertices_per_key_multiplier;
+    size_t vertices_per_key_divider;
+
+    /* give up once the graph would have more than this many vertices per
+     * key (16). at or below the starting size, this means giving up after
+     * the first iterations_grow_every_n_trials attempts, which are still made
+     * at the starting size.
+     */
+    size_t iterations_max_multiplier;
+
+    /* grow the graph by multiplier / divider (1075 / 1024) every this many
+     * attempts (5). the multiplier must be more than the divider.
+     */
+    size_t iterations_grow_every_n_trials;
+    size_t iterations_growth_multiplier;
+    size_t iterations_growth_multiplier_divider;
+
+    /* hash_insert() rebuilds once there are this many inserted keys (1024),
+     * or the keys of the hash over this divisor (16), whichever is more
+     */
+    size_t overflow_rebuild_min;
+    size_t overflow_rebuild_divisor;
+};
+
+/* see hash_create
+ *
+ * options may be NULL, which is the same as hash_create()
+ *
+ * with more than one thread, each thread tries its own salt at the same time
+ * and the first solution found cancels the attempts that came after it. the
+ * hash table created is the same for a given seed no matter how many threads
+ * are used.
+ *
+ * different seeds give different hash tables for the same keys. this shares
+ * no state with other calls, so any number of threads can each build their
+ * own hash table at the same time.
+ *
+ * if hash.c was compiled with HASH_NO_THREADS, n_threads is ignored.
+ */
+[[nodiscard]] struct hash * hash_create_ex(
+        struct hash_inputs * hash_inputs,
+        const struct hash_create_options * options
+    ) [[gnu::nonnull(1)]];
+
+/* create a hash_builder
+ *
+ * hash_create_ex() allocates the graphs it searches with (and the salts of
+ * the hash functions it tries), and frees them before it returns. building
+ * with hash_builder_build() instead keeps them in the builder for the next
+ * build, so that building again and again (e.g. hash_recycle_inputs(), then
+ * build, then again) allocates little more than the hash table itself once
+ * the builder has seen a build as big as it.
+ *
+ * a builder can only be used for one build at a time.
+ */
+[[nodiscard]] struct hash_builder * hash_builder_create();
+
+/* destroy a hash_builder, and the memory it kept */
+void hash_builder_destroy(
+        struct hash_builder * builder) [[gnu::nonnull(1)]];
+
+/* see hash_create_ex
+ *
+ * the same as hash_create_ex(hash_inputs, options) (and gives the same hash
+ * table), but with the scratch memory of builder
+ */
+[[nodiscard]] struct hash * hash_builder_build(
+        struct hash_builder * builder,
+        struct hash_inputs * hash_inputs,
+        const struct hash_create_options * options
+    ) [[gnu::nonnull(1, 2)]];
+
 /* destroy this hash table */
 void hash_destroy(struct hash * hash) [[gnu::nonnull(1)]];
 
-/* returns the number of keys in this hash */
+/* returns the number of keys in this hash (including any from
+ * hash_insert())
+ */
 size_t hash_n_keys(const struct hash * hash) [[gnu::nonnull(1)]];
 
 /* destroy this hash table, but extract the hash_inputs it was created with
@@ -101,6 +309,8 @@ struct hash_inputs * hash_recycle_inputs(
 
 /* returns a pointer to the keys inside this hash table and, if n_keys_out
  * is non-NULL, sets it to the number of keys
+ *
+ * keys from hash_insert() aren't included until the hash is rebuilt.
  */
 const struct hash_lookup_result * hash_get_keys(
         const struct hash * hash, size_t * n_keys_out) [[gnu::nonnull(1)]];
@@ -122,33 +332,183 @@ const struct hash_lookup_result * hash_lookup(
         size_t length
     ) [[gnu::nonnull(1, 2)]];
 
+/* look up this key of length in this hash and return its index, or SIZE_MAX
+ * if it isn't in this hash
+ *
+ * the index of a key is the order it was added to the hash_inputs in
+ * (counting from 0), and is also where it is in hash_get_keys().
+ */
+size_t hash_lookup_index(
+        const struct hash * hash,
+        const char * key,
+        size_t length
+    ) [[gnu::nonnull(1, 2)]];
+
+/* like hash_lookup_index(), for a key that is known to be in this hash
+ *
+ * this skips the tag and the key comparison, so a lookup is the two hash
+ * functions and two reads of the values. for a key that isn't in the hash,
+ * it returns either SIZE_MAX or the index of some other key.
+ *
+ * a key from hash_insert() only counts as in the hash once it's been rebuilt.
+ */
+size_t hash_lookup_index_unchecked(
+        const struct hash * hash,
+        const char * key,
+        size_t length
+    ) [[gnu::nonnull(1, 2)]];
+
+/* look up n keys at once, setting results[j] to what hash_lookup() would
+ * return for keys[j] of length lengths[j]
+ *
+ * this works through the keys a group at a time, prefetching ahead of each
+ * step, so when the hash table is much bigger than the cache it is much
+ * faster than calling hash_lookup() on each key in turn.
+ */
+void hash_lookup_batch(
+        const struct hash * hash,
+        const char * const * keys,
+        const size_t * lengths,
+        const struct hash_lookup_result ** results,
+        size_t n
+    ) [[gnu::nonnull(1, 2, 3, 4)]];
+
+/* add this key of length to a hash that has already been created,
+ * associating it with ptr, and return true, or return false if it is already
+ * in the hash (or is zero-length, or the hash was made with drop_keys)
+ *
+ * the key goes into a small table on the side, which lookups check when a
+ * key isn't in the hash itself, and gets the next index after every key
+ * already in the hash. once enough keys have been inserted (a sixteenth as
+ * many as are in the hash, but at least 1024), the hash is rebuilt with all
+ * of them, with the options it was created with, in place. the indices
+ * of the keys stay the same.
+ *
+ * this can't be called at the same time as anything else on this hash, and
+ * any results from before it (and from hash_get_keys()) may no longer be
+ * valid after.
+ */
+bool hash_insert(
+        struct hash * hash,
+        const char * key,
+        size_t length,
+        void * ptr
+    ) [[gnu::nonnull(1, 2)]];
+
+/* rebuild this hash in place, with all its keys (including those from
+ * hash_insert()) and the options it was created with
+ *
+ * returns false if it can't, in which case the hash is left as it was. as
+ * with hash_insert(), results from before this may no longer be valid.
+ */
+bool hash_rebuild(struct hash * hash) [[gnu::nonnull(1)]];
+
+/* create a handle for this hash, taking ownership of it
+ *
+ * a handle lets one thread (the writer) replace the hash while any number of
+ * others read it, without the readers ever waiting. each reading thread gets
+ * a hash_reader, and brackets its lookups with hash_reader_enter() and
+ * hash_reader_exit(). the writer builds a new hash with hash_handle_update()
+ * (or on its own, and hands it to hash_handle_publish()), and the old one is
+ * destroyed once no reader is still in it.
+ *
+ * the functions here that are for the writer can't be called by more than
+ * one thread at a time, and the hashes of a handle are only read:
+ * hash_insert(), hash_rebuild(), and the like can't be used on them.
+ */
+[[nodiscard]] struct hash_handle * hash_handle_create(
+        struct hash * hash) [[gnu::nonnull(1)]];
+
+/* destroy this handle along with its hash (and any it replaced that are
+ * still around)
+ *
+ * no thread can be reading through it, and its readers are destroyed too
+ */
+void hash_handle_destroy(struct hash_handle * handle) [[gnu::nonnull(1)]];
+
+/* return a new reader for this handle, for one thread to use
+ *
+ * this never waits, and can be called from any thread
+ */
+[[nodiscard]] struct hash_reader * hash_reader_create(
+        struct hash_handle * handle) [[gnu::nonnull(1)]];
+
+/* give this reader back (it must not be between enter and exit) */
+void hash_reader_destroy(struct hash_reader * reader) [[gnu::nonnull(1)]];
+
+/* return the handle's current hash, which stays valid (and is not destroyed,
+ * even if replaced) until hash_reader_exit()
+ *
+ * this never waits on the writer. a reader reads one hash at a time.
+ */
+const struct hash * hash_reader_enter(
+        struct hash_reader * reader) [[gnu::nonnull(1)]];
+
+/* stop reading the hash from hash_reader_enter() */
+void hash_reader_exit(struct hash_reader * reader) [[gnu::nonnull(1)]];
+
+/* (writer) make this hash what readers get from now on, taking ownership of
+ * it. the one it replaces is destroyed once no reader is in it.
+ */
+void hash_handle_publish(
+        struct hash_handle * handle,
+        struct hash * hash
+    ) [[gnu::nonnull(1, 2)]];
+
+/* (writer) build a new hash with every key of the current one plus those of
+ * delta (which may be NULL, and is left as it was) that aren't already in
+ * it, each once even if delta has it more than once, using the options the
+ * current one was created with, and publish it
+ *
+ * the new keys come after the old ones, so the index of every key stays the
+ * same. readers use the old hash until this publishes the new one.
+ *
+ * returns false if the new hash can't be created, in which case nothing
+ * changes
+ */
+bool hash_handle_update(
+        struct hash_handle * handle,
+        const struct hash_inputs * delta
+    ) [[gnu::nonnull(1)]];
+
+/* (writer) destroy the replaced hashes no reader is in any more, and return
+ * how many are still waiting on a reader
+ *
+ * hash_handle_publish() does this already. this is for when a reader was
+ * still in one then.
+ */
+size_t hash_handle_reclaim(struct hash_handle * handle) [[gnu::nonnull(1)]];
+
 /* the statistics filled by hash_get_statistics */
 struct hash_statistics {
     size_t key_length_max; /* the length of the longest key */
     size_t iterations; /* number of iterations */
-    size_t nodes_explored; /* number of vertices marked visited on across all
-                            * iterations
+    size_t nodes_explored; /* number of vertices marked visited while
+                            * resolving the graph (only the winning attempt's
+                            * graph is resolved, since cycles are caught
+                            * while edges are added)
                             */
-    size_t rand_calls; /* number of calls to rand() by the hash function */
+    size_t rand_calls; /* number of 64 bit random numbers drawn */
     size_t hashes_calculated; /* number of calls to the hash function */
+    size_t fingerprints_calculated; /* number of keys fingerprinted by this
+                                     * call to hash_create (i.e. not counting
+                                     * ones kept by the hash_inputs from
+                                     * before)
+                                     */
     size_t graph_size; /* size of the graph / "values" table */
+    size_t value_bits; /* bits each entry of the "values" table takes */
     size_t vertex_stack_capacity; /* amount of slots allocated for the vertex
                                    * stack
                                    */
-    size_t edges_allocated; /* number of edges allocated by realloc, i.e. not
-                             * including those pre-allocated
+    size_t edges_allocated; /* number of slots in the adjacency array (two per
+                             * key)
                              */
-    size_t edges_preallocated; /* number of edges allocated by preallocation */
-    size_t unneeded_edges_allocated; /* number of edges allocated on vertices
-                                      * where simply growing wouldn't have
-                                      * allocated them
-                                      */
-    size_t edge_capacity_min; /* the number of edge slots allocated on the
-                               * vertex where that number is smallest
-                               */
-    size_t edge_capacity_max; /* the number of edge slots allocated on the
-                               * vertex where that number is largest
-                               */
+    size_t degree_min; /* the number of edges on the vertex where that number
+                        * is smallest
+                        */
+    size_t degree_max; /* the number of edges on the vertex where that number
+                        * is largest
+                        */
     size_t net_memory_allocated; /* amount of memory allocated, counting only
                                   * the additional memory of reallocs, not
                                   * the whole amount
@@ -156,15 +516,11 @@ struct hash_statistics {
     size_t total_memory_allocated; /* amount of memory, counting each realloc
                                     * as a separate allocation
                                     */
-    size_t reallocs_edges; /* number of times an edge list was realloc'd */
     size_t reallocs_salt; /* number of times salt was realloc'd */
     size_t reallocs_stack; /* number of times the vertax stack was realloc'd */
     size_t reallocs_vertices; /* number of times the vertex list was
                                * realloc'd
                                */
-    size_t realloc_amount_edges; /* amount of memory returned by realloc when
-                                  * realloc'ing edges
-                                  */
     size_t realloc_amount_salt; /* amount of memory returned by realloc when
                                  * realloc'ing salt
                                  */
@@ -185,13 +541,80 @@ void hash_get_statistics(
         struct hash_statistics * statistics
     ) [[gnu::nonnull(1, 2)]];
 
+/* fill options with the options this hash was made with (for a hash from
+ * hash_load_mmap(), the ones it was saved with, as far as they matter to it),
+ * with every field that was 0 for its default set to the value that was used
+ */
+void hash_get_options(
+        const struct hash * hash,
+        struct hash_create_options * options
+    ) [[gnu::nonnull(1, 2)]];
+
+/* write this hash to a file at path, returning true on success
+ *
+ * the file holds the hash functions, values, tags and keys, laid out so
+ * that hash_load_mmap() can use them where they lie. each result's ptr is
+ * saved as an integer, so only ptrs that are not real pointers (indices,
+ * small values cast to void *) mean anything once loaded again.
+ *
+ * the file is only good on a machine with the same byte order and pointer
+ * width as the one that wrote it; hash_load_mmap() checks this.
+ *
+ * a hash with keys from hash_insert() needs hash_rebuild() first.
+ */
+bool hash_save(
+        const struct hash * hash,
+        const char * path
+    ) [[gnu::nonnull(1, 2)]];
+
+/* map a file written by hash_save() and return a hash that uses it in
+ * place, or NULL if the file cannot be read or is not a valid hash file
+ *
+ * nothing is rebuilt, so loading costs about as much as touching the pages
+ * lookups land on, and processes that load the same file share its pages.
+ * the mapping is released by hash_destroy(). a loaded hash has no
+ * statistics (hash_get_statistics() fills zeroes).
+ *
+ * only the header is checked, not the tables themselves, so only load files
+ * hash_save() wrote.
+ */
+[[nodiscard]] struct hash * hash_load_mmap(
+        const char * path
+    ) [[gnu::nonnull(1)]];
+
+/* write C source to a file at path that finds the keys of this hash without
+ * it: static const tables and a static inline name_lookup(key, length) that
+ * returns the index of key (the same as in hash_get_keys()) or -1
+ *
+ * for keys known when a program is built, so that it starts with the hash
+ * already made (and its tables in read-only memory.) every identifier the
+ * file declares starts with name, which must be a C identifier. the ptrs
+ * aren't written, only the keys.
+ *
+ * a hash made with HASH_CREATE_FINGERPRINT gives a file that only works on
+ * machines with the same byte order as this one.
+ *
+ * returns false if name isn't an identifier, path can't be written, this
+ * hash was made with drop_keys, or it has keys from hash_insert() that
+ * haven't been rebuilt into it
+ */
+bool hash_save_c(
+        const struct hash * hash,
+        const char * path,
+        const char * name
+    ) [[gnu::nonnull(1, 2, 3)]];
+
 /* create an empty hash_inputs structure */
 [[nodiscard]] struct hash_inputs * hash_inputs_create();
 
 /* create a hash_inputs structure containing all the keys in this hash
  *
- * note that if you are done with the hash, hash_recycles_inputs is more
- * efficient because it recycles the keys in place.
+ * every key is copied, even the ones the hash adopted from
+ * hash_inputs_add_no_copy(), and the hash is left as it was. if you are done
+ * with the hash, hash_recycle_inputs() copies the keys too, but adopts the
+ * adopted keys again and hands over the fingerprints the hash already
+ * computed, so that creating a hash from its result doesn't compute them
+ * again.
  */
 [[nodiscard]] struct hash_inputs * hash_inputs_from_hash(
         struct hash * hash) [[gnu::nonnull(1)]];
@@ -204,13 +627,14 @@ void hash_inputs_destroy(
 size_t hash_inputs_n_keys(
         const struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]];
 
-/* destroy a hash_inputs structure without free'ing its keys
+/* destroy a hash_inputs structure without free'ing the keys added with
+ * hash_inputs_add_no_copy()
  *
  * use this in conjunction with hash_inputs_add_no_copy()
  *
- * if hash_inputs_add() or hash_inputs_add_safe() have been called on this
- * hash_inputs (or if they were called on any of its parents and
- * hash_reycle_inputs() is involved), calling this function will leak memory.
+ * keys copied in by hash_inputs_add() or hash_inputs_add_safe() (including
+ * on any of its parents, if hash_recycle_inputs() is involved) are still
+ * free'd, since they belong to hash_inputs.
  */
 void hash_inputs_destroy_except_keys(
         struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]];
@@ -230,15 +654,19 @@ void hash_inputs_at_least(
 /* add this key of the given length to this hash_inputs, associating it with
  * ptr
  *
+ * the key is copied (into storage shared with the other keys of hash_inputs,
+ * which is free'd all at once), so the caller keeps ownership of key.
+ *
  * a zero-length key cannot be hashed and will be ignored. A warning will
  * be issued unless HASH_NO_WARNINGS
  *
- * this key must not already be in hash_inputs. if it is, the behavior of a
- * hash table generated from these keys becomes undefined.
+ * this key must not already be in hash_inputs. if it is, hash_create() will
+ * fail (with a warning naming the indices of the two copies, unless
+ * HASH_NO_WARNINGS) before it starts searching, since it checks the keys for
+ * duplicates first.
  *
- * see hash_inputs_add_safe(), but hash_inputs is not optimized for this case
- * (it does not sort itself) and so hash_inputs_add() is the preferred method
- * of adding keys. sort/deduplicate them beforehand!
+ * if there might be duplicates, see hash_inputs_add_safe(), or add them all
+ * and then call hash_inputs_deduplicate().
  */
 void hash_inputs_add(
         struct hash_inputs * hash_inputs,
@@ -249,11 +677,11 @@ void hash_inputs_add(
 
 /* see hash_inputs_add
  *
- * this lifts the requirement of key uniqueness by comparing this key to every
- * key already in the table. this will not protect future calls to
- * hash_inputs_add() with this key!
- *
- * use mindfully and with caution
+ * this lifts the requirement of key uniqueness by looking this key up in a
+ * set of the keys already in hash_inputs (which it keeps from one call to
+ * the next, and which costs a few words per key), so adding n keys
+ * this way takes O(n). if the key is already there, this does nothing. this
+ * will not protect future calls to hash_inputs_add() with this key!
  */
 void hash_inputs_add_safe(
         struct hash_inputs * hash_inputs,
@@ -262,10 +690,24 @@ void hash_inputs_add_safe(
         void * ptr
     ) [[gnu::nonnull(1, 2)]];
 
+/* remove every key from hash_inputs that's the same as one before it,
+ * returning how many were removed
+ *
+ * the first copy of each key (and its ptr) is kept, and the keys keep their
+ * order. this takes one pass, with a set of the keys on their fingerprints.
+ *
+ * keys removed that were added with hash_inputs_add_no_copy() are free'd
+ * (hash_inputs owns them), even if hash_inputs_destroy_except_keys() is what
+ * will be called on hash_inputs later.
+ */
+size_t hash_inputs_deduplicate(
+        struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]];
+
 /* see hash_inputs_add
  *
  * this does not make a copy of key and so the key passed must not be free'd
  * except by a call to hash_inputs_destroy() (or, eventually, hash_destroy.)
+ * it must have been allocated with malloc().
  *
  * notably, this also does not guarantee that the key will be null-terminated.
  *
@@ -281,6 +723,39 @@ void hash_inputs_add_no_copy(
         void * ptr
     ) [[gnu::nonnull(1, 2)]];
 
+/* see hash_inputs_add
+ *
+ * add n keys at once, where key i is keys[i] of length lengths[i] and is
+ * associated with ptrs[i] (or NULL, if ptrs is NULL)
+ *
+ * room for all of the keys (and copies of them) is made up front, so this
+ * allocates at most twice no matter how large n is
+ */
+void hash_inputs_add_many(
+        struct hash_inputs * hash_inputs,
+        const char * const * keys,
+        const size_t * lengths,
+        void * const * ptrs,
+        size_t n
+    ) [[gnu::nonnull(1, 2, 3)]];
+
+/* see hash_inputs_add
+ *
+ * add n keys at once from one packed buffer, where key i is the bytes from
+ * buffer[offsets[i]] up to (but not including) buffer[offsets[i + 1]], and is
+ * associated with ptrs[i] (or NULL, if ptrs is NULL.) offsets must have n + 1
+ * entries and never decrease.
+ *
+ * like hash_inputs_add_many(), this allocates at most twice
+ */
+void hash_inputs_add_packed(
+        struct hash_inputs * hash_inputs,
+        const char * buffer,
+        const size_t * offsets,
+        void * const * ptrs,
+        size_t n
+    ) [[gnu::nonnull(1, 2, 3)]];
+
 /* apply this function over every key */
 void hash_inputs_apply(
         const struct hash_inputs * hash_inputs,
@@ -292,6 +767,10 @@ void hash_inputs_apply(
 /* apply this function over every key and then destroy the hash inputs
  * (without free'ing the keys, since this is designed to let them escape via
  * the apply)
+ *
+ * keys added with hash_inputs_add() or hash_inputs_add_safe() are stored in
+ * shared chunks, so fn is given a malloc'd copy of each of those instead.
+ * either way, every key fn is given can be free'd on its own.
  */
 void hash_inputs_apply_and_destroy(
         struct hash_inputs * hash_inputs,
@@ -309,8 +788,8 @@ struct hash_inputs_statistics {
                        */
     size_t capacity; /* the internal capacity of the pool
                       * may be greater than the number of keys if the grow
-                      * or at_least functions were used, or if
-                      * hash_inputs_grow_increment is more than 1
+                      * or at_least functions were used, or because adding
+                      * keys grows the pool geometrically
                       */
     size_t n_safe_adds_were_safe; /* how many times did hash_inputs_add_safe
                                    * get called when the key was not already
@@ -320,6 +799,9 @@ struct hash_inputs_statistics {
                                      * get called when the key WAS already
                                      * added
                                      */
+    size_t n_key_chunks; /* how many chunks of key storage were allocated to
+                          * hold the keys copied in by hash_inputs_add[_safe]
+                          */
 };
 
 /* fill statistics with statistics on this hash_inputs
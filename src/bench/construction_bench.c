@@ -0,0 +1,346 @@
+/* File: src/bench/construction_bench.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* construction_bench: time hash_create() over synthetic key sets shaped like
+ * real ones
+ *
+ * each dataset is generated in memory, one size at a time, and then only
+ * hash_create_ex() is timed. every build runs in a child process of its own,
+ * so that the peak memory reported (the growth of the peak resident set
+ * across hash_create_ex(), which doesn't count the hash_inputs) belongs to
+ * that build alone.
+ *
+ * this is linked against a hash.c compiled with HASH_STATISTICS, which is
+ * where the iteration and allocation counts come from.
+ */
+#include "hash.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* the longest key any dataset makes */
+constexpr size_t key_length_max = 128;
+
+/* write key i of a dataset into key, returning its length */
+typedef size_t (*make_key_fn)(char * key, size_t i);
+
+/* splitmix64, which is a bijection, so mixing distinct numbers gives
+ * distinct numbers
+ */
+static uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/* write i in base 36 to key, returning how many characters that took */
+static size_t base36(char * key, uint64_t i)
+{
+    static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    char reversed[16];
+    size_t n = 0;
+    do {
+        reversed[n++] = digits[i % 36];
+        i /= 36;
+    } while (i);
+    for (size_t j = 0; j < n; j++) {
+        key[j] = reversed[n - j - 1];
+    }
+    return n;
+}
+
+/* URLs under a handful of hosts, which share long prefixes */
+static size_t make_url(char * key, size_t i)
+{
+    static const char * prefixes[] = {
+        "https://www.example.com/catalog/products/",
+        "https://www.example.com/catalog/reviews/",
+        "https://static.example.com/assets/images/thumbnails/",
+        "https://api.example.com/v2/accounts/"
+    };
+    uint64_t r = mix(i);
+    const char * prefix = prefixes[r % 4];
+    size_t length = strlen(prefix);
+    memcpy(key, prefix, length);
+    length += base36(&key[length], r >> 40);
+    key[length++] = '/';
+    length += base36(&key[length], i);
+    memcpy(&key[length], "?ref=home", 9);
+    return length + 9;
+}
+
+/* short identifiers, like those of a programming language */
+static size_t make_identifier(char * key, size_t i)
+{
+    uint64_t r = mix(i);
+    size_t length = r % 4;
+    for (size_t j = 0; j < length; j++) {
+        r /= 26;
+        key[j] = 'a' + r % 26;
+    }
+    key[length++] = '_';
+    return length + base36(&key[length], i);
+}
+
+/* version 4 UUIDs in their usual 36 character form */
+static size_t make_uuid(char * key, size_t i)
+{
+    static const char digits[] = "0123456789abcdef";
+    uint64_t high = mix(i), low = mix(high ^ i);
+    high = (high & ~0xf000ULL) | 0x4000ULL;
+    low = (low & ~(0x3ULL << 62)) | (0x2ULL << 62);
+    size_t length = 0;
+    for (size_t j = 0; j < 32; j++) {
+        if (j == 8 || j == 12 || j == 16 || j == 20) {
+            key[length++] = '-';
+        }
+        uint64_t word = j < 16 ? high : low;
+        key[length++] = digits[(word >> (60 - (j % 16) * 4)) & 0xf];
+    }
+    return length;
+}
+
+/* pronounceable words of two to about a dozen letters */
+static size_t make_word(char * key, size_t i)
+{
+    static const char consonants[] = "bdfgklmnprstvz";
+    static const char vowels[] = "aeiou";
+    constexpr size_t n_syllables = (sizeof(consonants) - 1) * 5;
+    size_t length = 0;
+    uint64_t n = i;
+    do {
+        key[length++] = consonants[n % n_syllables / 5];
+        key[length++] = vowels[n % 5];
+        n /= n_syllables;
+    } while (n--);
+    return length;
+}
+
+/* decimal integers, counting up */
+static size_t make_integer(char * key, size_t i)
+{
+    return sprintf(key, "%zu", i);
+}
+
+/* 64 random lower case letters, like the keys benchmark.sh uses (but for
+ * the first seven, which spell out i so that keys are distinct)
+ */
+static size_t make_random(char * key, size_t i)
+{
+    uint64_t r = i;
+    for (size_t j = 0; j < 64; j++) {
+        if (j % 8 == 0) {
+            r = mix(r);
+        }
+        key[j] = 'a' + (r >> (j % 8 * 8)) % 26;
+    }
+    for (size_t j = 0; j < 7; j++) {
+        key[j] = 'a' + i % 26;
+        i /= 26;
+    }
+    return 64;
+}
+
+static const struct dataset {
+    const char * name;
+    make_key_fn make_key;
+} datasets[] = {
+    { "url", make_url },
+    { "ident", make_identifier },
+    { "uuid", make_uuid },
+    { "word", make_word },
+    { "integer", make_integer },
+    { "random64", make_random }
+};
+
+constexpr size_t n_datasets = sizeof(datasets) / sizeof(*datasets);
+
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* the peak resident set size of this process so far, in bytes */
+static size_t peak_memory()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (size_t)usage.ru_maxrss * 1024;
+}
+
+/* build one hash of n_keys keys of dataset and print a line about it */
+static int run(
+        const struct dataset * dataset,
+        size_t n_keys,
+        const struct hash_create_options * options
+    )
+{
+    char key[key_length_max];
+    size_t key_bytes = 0;
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    hash_inputs_at_least(hash_inputs, n_keys);
+    for (size_t i = 0; i < n_keys; i++) {
+        size_t length = dataset->make_key(key, i);
+        key_bytes += length;
+        hash_inputs_add(hash_inputs, key, length, NULL);
+    }
+
+    size_t memory_before = peak_memory();
+    double start = now();
+    struct hash * hash = hash_create_ex(hash_inputs, options);
+    double seconds = now() - start;
+    size_t memory_after = peak_memory();
+    hash_inputs_destroy(hash_inputs);
+
+    if (!hash) {
+        printf("%-9s %10zu  failed after %.3f s\n",
+                dataset->name, n_keys, seconds);
+        return 1;
+    }
+
+    struct hash_statistics statistics;
+    hash_get_statistics(hash, &statistics);
+    printf("%-9s %10zu %6.1f %10.3f %6zu %8.2f %10.1f %10.1f\n",
+            dataset->name, n_keys, (double)key_bytes / n_keys, seconds,
+            statistics.iterations,
+            (double)(statistics.graph_size * statistics.value_bits) / n_keys,
+            (double)statistics.total_memory_allocated / n_keys,
+            (double)(memory_after - memory_before) / (1 << 20));
+    hash_destroy(hash);
+    return 0;
+}
+
+static void usage(FILE * file, const char * argv0)
+{
+    fprintf(file,
+            "usage: %s [OPTIONS]\n"
+            "\n"
+            "  -d NAMES    comma separated datasets, out of url, ident, uuid,\n"
+            "              word, integer and random64 (default: all)\n"
+            "  -s SIZES    comma separated numbers of keys (default\n"
+            "              1000,100000,1000000)\n"
+            "  -f          use HASH_CREATE_FINGERPRINT\n"
+            "  -t THREADS  search on THREADS threads (default 1)\n"
+            "  -h          print this and exit\n"
+            "\n"
+            "columns: mean key length, seconds in hash_create_ex(), search\n"
+            "iterations, bits of values table per key, bytes allocated per\n"
+            "key during the build, and growth of peak memory in MiB\n",
+            argv0);
+}
+
+int main(int argc, char ** argv)
+{
+    size_t sizes[32] = { 1000, 100000, 1000000 };
+    size_t n_sizes = 3;
+    bool selected[n_datasets];
+    const char * names = NULL;
+    struct hash_create_options options = { };
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-h")) {
+            usage(stdout, argv[0]);
+            return 0;
+        } else if (!strcmp(argv[i], "-f")) {
+            options.mode = HASH_CREATE_FINGERPRINT;
+        } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            names = argv[++i];
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            const char * s = argv[++i];
+            n_sizes = 0;
+            while (*s && n_sizes < 32) {
+                char * end;
+                sizes[n_sizes++] = strtoull(s, &end, 10);
+                if (end == s) {
+                    usage(stderr, argv[0]);
+                    return 1;
+                }
+                s = *end == ',' ? end + 1 : end;
+            }
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            options.n_threads = strtoul(argv[++i], NULL, 0);
+        } else {
+            usage(stderr, argv[0]);
+            return 1;
+        }
+    }
+
+    for (size_t d = 0; d < n_datasets; d++) {
+        selected[d] = !names;
+    }
+    for (const char * s = names; s && *s; ) {
+        size_t length = strcspn(s, ",");
+        size_t d = 0;
+        while (d < n_datasets && (strlen(datasets[d].name) != length ||
+                    strncmp(datasets[d].name, s, length))) {
+            d++;
+        }
+        if (d == n_datasets) {
+            fprintf(stderr, "%s: no dataset %.*s\n",
+                    argv[0], (int)length, s);
+            return 1;
+        }
+        selected[d] = true;
+        s += length + (s[length] == ',');
+    }
+
+    printf("%-9s %10s %6s %10s %6s %8s %10s %10s\n",
+            "dataset", "keys", "len", "seconds", "iters", "bits/key",
+            "alloc B/k", "peak MiB");
+    fflush(stdout);
+
+    int status = 0;
+    for (size_t d = 0; d < n_datasets; d++) {
+        if (!selected[d]) {
+            continue;
+        }
+        for (size_t s = 0; s < n_sizes; s++) {
+            if (sizes[s] == 0) {
+                continue;
+            }
+            pid_t pid = fork();
+            if (pid == 0) {
+                int result = run(&datasets[d], sizes[s], &options);
+                fflush(stdout);
+                _exit(result);
+            } else if (pid < 0) {
+                fprintf(stderr, "%s: couldn't fork\n", argv[0]);
+                return 1;
+            }
+            int child_status;
+            waitpid(pid, &child_status, 0);
+            if (!WIFEXITED(child_status) || WEXITSTATUS(child_status)) {
+                status = 1;
+            }
+        }
+    }
+
+    return status;
+}
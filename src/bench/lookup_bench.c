@@ -0,0 +1,398 @@
+/* File: src/bench/lookup_bench.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* lookup_bench: time hash_lookup() alone, on 1 to N threads at once
+ *
+ * for each table size, the keys are generated and the hash created before
+ * anything is timed, and each thread's queries are drawn up front too, so
+ * what's timed is only the lookups. every query is for either a key of the
+ * table or a key that isn't in it (in the given proportion), picked either
+ * uniformly or with a Zipf distribution (s = 0.99, with the popular keys
+ * scattered through the table rather than next to each other).
+ *
+ * throughput is every lookup of every thread over the time the slowest
+ * thread took. one lookup in latency_sample_every is timed on its own for the
+ * percentiles, which costs a clock read each, so they're a little high.
+ */
+#include "hash.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* how often a lookup is timed on its own */
+constexpr size_t latency_sample_every = 16;
+
+/* the exponent of the Zipf distribution */
+constexpr double zipf_s = 0.99;
+
+enum distribution {
+    DISTRIBUTION_UNIFORM,
+    DISTRIBUTION_ZIPF
+};
+
+static const char * distribution_names[] = {
+    [DISTRIBUTION_UNIFORM] = "uniform",
+    [DISTRIBUTION_ZIPF] = "zipf"
+};
+
+/* what every thread of one run shares */
+struct run {
+    const struct hash * hash;
+    pthread_barrier_t barrier;
+};
+
+/* one thread of a run */
+struct worker {
+    struct run * run;
+    const char ** queries;
+    size_t n_queries;
+    size_t length;
+    size_t hits;
+    double seconds;
+    double * latencies; /* in ns, one per latency_sample_every queries */
+    size_t n_latencies;
+};
+
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* splitmix64, for everything random here */
+static uint64_t next_random(uint64_t * state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* a uniform double in [0, 1) */
+static double next_unit(uint64_t * state)
+{
+    return (next_random(state) >> 11) * 0x1.0p-53;
+}
+
+/* a Zipf distribution over 0 to n - 1, by the method of Gray et al.,
+ * "Quickly Generating Billion-Record Synthetic Databases" (as in YCSB)
+ */
+struct zipf {
+    size_t n;
+    double alpha, zeta_n, eta;
+};
+
+static struct zipf zipf_create(size_t n)
+{
+    double zeta_n = 0, zeta_2 = 1 + pow(2, -zipf_s);
+    for (size_t i = 1; i <= n; i++) {
+        zeta_n += pow(i, -zipf_s);
+    }
+    return (struct zipf) {
+        .n = n,
+        .alpha = 1 / (1 - zipf_s),
+        .zeta_n = zeta_n,
+        .eta = (1 - pow(2.0 / n, 1 - zipf_s)) / (1 - zeta_2 / zeta_n)
+    };
+}
+
+/* a rank from this distribution, then moved somewhere else in 0 to n - 1 so
+ * that the popular ranks aren't all together
+ */
+static size_t zipf_next(const struct zipf * zipf, uint64_t * state)
+{
+    double u = next_unit(state);
+    double uz = u * zipf->zeta_n;
+    size_t rank;
+    if (uz < 1) {
+        rank = 0;
+    } else if (uz < 1 + pow(0.5, zipf_s)) {
+        rank = 1;
+    } else {
+        rank = zipf->n * pow(zipf->eta * u - zipf->eta + 1, zipf->alpha);
+    }
+    if (rank >= zipf->n) {
+        rank = zipf->n - 1;
+    }
+    uint64_t scramble = rank;
+    return next_random(&scramble) % zipf->n;
+}
+
+/* write key i (a hit if hit, a miss otherwise) of length into key
+ *
+ * the first eight characters spell out i, so keys are distinct, and a miss
+ * starts with an upper case letter where keys don't
+ */
+static void make_key(char * key, size_t length, size_t i, bool hit)
+{
+    uint64_t state = i * 2 + hit;
+    for (size_t j = 0; j < length; j++) {
+        key[j] = 'a' + next_random(&state) % 26;
+    }
+    for (size_t j = 0; j < 8 && j < length; j++) {
+        key[j] = 'a' + i % 26;
+        i /= 26;
+    }
+    if (!hit) {
+        key[0] += 'A' - 'a';
+    }
+}
+
+static void * worker_run(void * arg)
+{
+    struct worker * worker = arg;
+    const struct hash * hash = worker->run->hash;
+    size_t hits = 0;
+
+    pthread_barrier_wait(&worker->run->barrier);
+    double start = now();
+    for (size_t i = 0; i < worker->n_queries; i++) {
+        if (i % latency_sample_every == 0) {
+            double before = now();
+            hits += hash_lookup(hash, worker->queries[i], worker->length) !=
+                NULL;
+            worker->latencies[worker->n_latencies++] = (now() - before) * 1e9;
+        } else {
+            hits += hash_lookup(hash, worker->queries[i], worker->length) !=
+                NULL;
+        }
+    }
+    worker->seconds = now() - start;
+    worker->hits = hits;
+    return NULL;
+}
+
+static int compare_doubles(const void * a, const void * b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(FILE * file, const char * argv0)
+{
+    fprintf(file,
+            "usage: %s [OPTIONS]\n"
+            "\n"
+            "  -s SIZES    comma separated numbers of keys (default\n"
+            "              1000,100000,4000000)\n"
+            "  -t N        go up to N threads, doubling from 1 (default: the\n"
+            "              number of CPUs online)\n"
+            "  -p HITS     comma separated percentages of queries that are\n"
+            "              hits (default 100,50,0)\n"
+            "  -n N        lookups per thread per run (default 2000000)\n"
+            "  -l LENGTH   length of each key (default 16)\n"
+            "  -f          use HASH_CREATE_FINGERPRINT\n"
+            "  -g BITS     keep tags of BITS bits\n"
+            "  -h          print this and exit\n",
+            argv0);
+}
+
+/* parse a comma separated list of numbers into values, returning how many */
+static size_t parse_list(const char * s, size_t * values, size_t capacity)
+{
+    size_t n = 0;
+    while (*s && n < capacity) {
+        char * end;
+        values[n++] = strtoull(s, &end, 10);
+        s = *end == ',' ? end + 1 : end;
+        if (end == s && *s) {
+            break;
+        }
+    }
+    return n;
+}
+
+int main(int argc, char ** argv)
+{
+    size_t sizes[32] = { 1000, 100000, 4000000 };
+    size_t n_sizes = 3;
+    size_t hit_percents[32] = { 100, 50, 0 };
+    size_t n_hit_percents = 3;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_threads = cpus > 0 ? cpus : 1;
+    size_t n_queries = 2000000;
+    size_t length = 16;
+    struct hash_create_options options = { };
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-h")) {
+            usage(stdout, argv[0]);
+            return 0;
+        } else if (!strcmp(argv[i], "-f")) {
+            options.mode = HASH_CREATE_FINGERPRINT;
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            n_sizes = parse_list(argv[++i], sizes, 32);
+        } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+            n_hit_percents = parse_list(argv[++i], hit_percents, 32);
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            max_threads = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            n_queries = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+            length = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-g") && i + 1 < argc) {
+            options.tag_bits = strtoul(argv[++i], NULL, 10);
+        } else {
+            usage(stderr, argv[0]);
+            return 1;
+        }
+    }
+
+    if (length < 8 || max_threads < 1 || n_queries < 1) {
+        fprintf(stderr, "%s: keys need at least 8 bytes, and there needs "
+                "to be at least one thread and query\n", argv[0]);
+        return 1;
+    }
+
+    printf("%10s %7s %8s %5s %12s %8s %8s %8s\n",
+            "keys", "threads", "access", "hits", "lookups/s",
+            "p50 ns", "p99 ns", "p999 ns");
+
+    for (size_t s = 0; s < n_sizes; s++) {
+        size_t n_keys = sizes[s];
+
+        /* the keys, then as many keys that aren't in the table */
+        char * keys = malloc(n_keys * length * 2);
+        struct hash_inputs * hash_inputs = hash_inputs_create();
+        hash_inputs_at_least(hash_inputs, n_keys);
+        for (size_t i = 0; i < n_keys; i++) {
+            make_key(&keys[i * length], length, i, true);
+            make_key(&keys[(n_keys + i) * length], length, i, false);
+            hash_inputs_add(hash_inputs, &keys[i * length], length, NULL);
+        }
+        struct hash * hash = hash_create_ex(hash_inputs, &options);
+        hash_inputs_destroy(hash_inputs);
+        if (!hash) {
+            fprintf(stderr, "%s: couldn't create a hash of %zu keys\n",
+                    argv[0], n_keys);
+            free(keys);
+            return 1;
+        }
+
+        struct zipf zipf = zipf_create(n_keys);
+
+        for (enum distribution d = DISTRIBUTION_UNIFORM;
+                d <= DISTRIBUTION_ZIPF; d++) {
+            for (size_t h = 0; h < n_hit_percents; h++) {
+                for (size_t n_threads = 1; n_threads <= max_threads;
+                        n_threads = n_threads * 2 > max_threads &&
+                        n_threads < max_threads ?
+                            max_threads : n_threads * 2) {
+                    struct run run = { .hash = hash };
+                    pthread_barrier_init(&run.barrier, NULL, n_threads);
+                    struct worker * workers =
+                        calloc(n_threads, sizeof(*workers));
+                    size_t expected_hits = 0;
+
+                    for (size_t t = 0; t < n_threads; t++) {
+                        struct worker * worker = &workers[t];
+                        uint64_t state = t + 1;
+                        *worker = (struct worker) {
+                            .run = &run,
+                            .queries = malloc(
+                                    sizeof(*worker->queries) * n_queries),
+                            .n_queries = n_queries,
+                            .length = length,
+                            .latencies = malloc(sizeof(*worker->latencies) *
+                                (n_queries / latency_sample_every + 1))
+                        };
+                        for (size_t q = 0; q < n_queries; q++) {
+                            size_t i = d == DISTRIBUTION_ZIPF ?
+                                zipf_next(&zipf, &state) :
+                                next_random(&state) % n_keys;
+                            bool hit =
+                                next_random(&state) % 100 < hit_percents[h];
+                            expected_hits += hit;
+                            worker->queries[q] =
+                                &keys[(hit ? i : n_keys + i) * length];
+                        }
+                    }
+
+                    pthread_t * threads =
+                        malloc(sizeof(*threads) * n_threads);
+                    for (size_t t = 0; t < n_threads; t++) {
+                        pthread_create(
+                                &threads[t], NULL, worker_run, &workers[t]);
+                    }
+
+                    double seconds = 0;
+                    size_t hits = 0, n_latencies = 0;
+                    for (size_t t = 0; t < n_threads; t++) {
+                        pthread_join(threads[t], NULL);
+                        if (workers[t].seconds > seconds) {
+                            seconds = workers[t].seconds;
+                        }
+                        hits += workers[t].hits;
+                        n_latencies += workers[t].n_latencies;
+                    }
+
+                    double * latencies =
+                        malloc(sizeof(*latencies) * n_latencies);
+                    n_latencies = 0;
+                    for (size_t t = 0; t < n_threads; t++) {
+                        memcpy(&latencies[n_latencies], workers[t].latencies,
+                                sizeof(*latencies) * workers[t].n_latencies);
+                        n_latencies += workers[t].n_latencies;
+                        free(workers[t].latencies);
+                        free(workers[t].queries);
+                    }
+                    qsort(latencies, n_latencies, sizeof(*latencies),
+                            compare_doubles);
+
+                    if (hits != expected_hits) {
+                        fprintf(stderr, "%s: %zu hits where there should be "
+                                "%zu\n", argv[0], hits, expected_hits);
+                        return 1;
+                    }
+
+                    printf("%10zu %7zu %8s %4zu%% %12.0f %8.0f %8.0f %8.0f\n",
+                            n_keys, n_threads, distribution_names[d],
+                            hit_percents[h],
+                            n_threads * n_queries / seconds,
+                            latencies[n_latencies / 2],
+                            latencies[n_latencies * 99 / 100],
+                            latencies[n_latencies * 999 / 1000]);
+                    fflush(stdout);
+
+                    free(latencies);
+                    free(threads);
+                    free(workers);
+                    pthread_barrier_destroy(&run.barrier);
+
+                    if (n_threads == max_threads) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        hash_destroy(hash);
+        free(keys);
+    }
+
+    return 0;
+}
@@ -32,38 +32,87 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <assert.h>
 #include <assert.h>
 
-#if !defined(HASH_NO_WARNINGS)
+#if !defined(HASH_NO_THREADS)
+#include <pthread.h>
+#endif /* HASH_NO_THREADS */
+
 #include <stdio.h>
-#endif /* HASH_NO_WARNINGS */
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sched.h>
+#endif /* _WIN32 */
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(HASH_NO_SIMD)
+#define HASH_X86_KERNELS
+#include <immintrin.h>
+#endif /* HASH_NO_SIMD */
 
 /*
  * TUNING VALUES
  */
 
-#ifndef HASH_PREALLOC_EDGES
-#define HASH_PREALLOC_EDGES 12
-#endif /* HASH_PREALLOC_EDGES */
-
 /* turn this on to test worst-case runtime */
 //#define HASH_SIMULATE_WORST_CASE
 
 /* when adding hash inputs when space hasn't been preallocated by calls to
- * hash_inputs_grow and hash_inputs_at_least
+ * hash_inputs_grow and hash_inputs_at_least, the capacity is doubled (but to
+ * at least this much), so that adding n keys one at a time only reallocs
+ * about log2(n) times
+ */
+constexpr size_t hash_inputs_grow_min = 16;
+
+/* keys added with hash_inputs_add are copied into chunks that start at the min
+ * size and double each time a new one is needed, up to the max size (a key
+ * longer than that gets a chunk of exactly its own size)
  */
-constexpr size_t hash_inputs_grow_increment = 1;
+constexpr size_t hash_key_chunk_size_min = 64 * 1024;
+constexpr size_t hash_key_chunk_size_max = 16 * 1024 * 1024;
+
+/* the values from here to hash_overflow_rebuild_divisor are the defaults for
+ * the fields of struct hash_create_options with the same names, which can
+ * set them per hash
+ */
+
+/* hash_create starts the graph with this many vertices per key (scaled by the
+ * divider, so 2.09)
+ *
+ * a random graph with n edges and c * n vertices is acyclic with probability
+ * about sqrt((c - 2) / c) as n grows, so below c = 2 attempts essentially
+ * never succeed. at 2.09 about one attempt in five does. (see section 4 of the
+ * CHM paper.)
+ */
+constexpr size_t hash_vertices_per_key_multiplier = 209;
+constexpr size_t hash_vertices_per_key_divider = 100;
+
+/* if true, f1 maps into the lower half of the vertices and f2 into the upper
+ * half, so the graph is bipartite and no key can ever become a self-loop
+ */
+constexpr bool hash_split_vertices = true;
 
 /* hash_create gives up after the number of vertices has grown such that it
  * exceeds this multiplied by the number of keys
  *
- * the value 650 was chosen such that, with a multiplier and divider for growth
- * of 1075 and 1024 (though these don't have a huge effect, later iterations
- * dominate) the worst-case runtime for 10,000 random keys of 64 bytes is about
- * five seconds on my laptop. #science
+ * this used to be 650, back when the graph started at one vertex per key and
+ * had to grow past two per key before anything could succeed, which made the
+ * worst-case runtime for 10,000 random keys of 64 bytes about five seconds.
+ * now that the graph starts at a viable size, 16 still leaves room for about
+ * 40 growths (about 200 attempts) and gives up on those same keys in well
+ * under half a second. random keys essentially never get this far. (duplicate
+ * keys would always fail, but they're caught before the search starts; see
+ * hash_inputs_find_twins.)
  */
-constexpr size_t hash_iterations_max_multiplier = 650;
+constexpr size_t hash_iterations_max_multiplier = 16;
 
 /* hash_create increases the size of the graph after this number of iterations
  * (see the multiplier, though)
@@ -79,20 +128,25 @@ constexpr size_t hash_iterations_grow_every_n_trials = 5;
 constexpr size_t hash_iterations_growth_multiplier = 1075;
 constexpr size_t hash_iterations_growth_multiplier_divider = 1024;
 
-/* this is a tuning value that causes some number of edges to be preallocated
- * for every vertex. generally, the number needed (for, say, 100k keys) is
- * between 0 and 12 per vertex*. set it somewhere between this, causing the
- * hash to use more memory in exchange for calling realloc less.
- *
- * in the case of 100k keys of 64 bytes, the improvement for a prealloc of
- * 12 is just under 5%. this results in an unneeded_edges_allocated of about
- * 150k, or about 2.3MB of extra memory usage (to run the function, this does
- * not persist after hash_create() returns.)
- *
- * *technically, it's sometimes 13 or 14, which in all observed cases resulted
- * in <5 re-allocations--not a number worth worrying about.
+/* hash_insert rebuilds the hash once the keys inserted since the last build
+ * number this many, or the keys in the hash divided by the divisor, whichever
+ * is more. rebuilding takes about as long as hash_create, so over the inserts
+ * that lead up to it this is at most 1 / divisor of that per key inserted.
+ */
+constexpr size_t hash_overflow_rebuild_min = 1024;
+constexpr size_t hash_overflow_rebuild_divisor = 16;
+
+/* hash_lookup_batch works on this many keys at a time. it needs to be enough
+ * that the misses of one step of the group cover each other, but few enough
+ * that what was prefetched is still there at the next step.
+ */
+constexpr size_t hash_lookup_batch_group = 16;
+
+/* a thread that finds a result of a hash loaded by hash_load_mmap being filled
+ * in by another thread spins (with a pause) this many times before it starts
+ * yielding instead, in case the one filling it in isn't running
  */
-constexpr size_t hash_prealloc_edges = HASH_PREALLOC_EDGES;
+constexpr size_t hash_result_spins_max = 64;
 
 /*
  * TYPES
@@ -103,10 +157,12 @@ typedef ssize_t hash_function_result;
 /* the state describing a hash function
  */
 struct hash_function {
-    size_t * salt;
+    uint32_t * salt; /* each less than n, which always fits */
     size_t salt_length;
     size_t salt_capacity;
-    size_t n;
+    uint64_t seed; /* used instead of salt by HASH_CREATE_FINGERPRINT */
+    size_t offset; /* the first vertex this function maps to */
+    size_t n; /* the number of vertices this function maps to */
 };
 
 /* an individual key
@@ -119,40 +175,314 @@ struct hash_input {
     void * ptr;
 };
 
+/* a chunk of key storage for a hash_inputs
+ *
+ * keys copied into a hash_inputs are packed one after another (each with its
+ * null terminator) into a list of these, newest first. this makes adding a
+ * key a copy rather than a malloc, keeps keys that were added together next
+ * to each other in memory, and lets them all be free'd a chunk at a time.
+ */
+struct hash_key_chunk {
+    struct hash_key_chunk * next;
+    size_t length;
+    size_t capacity;
+    char data[];
+};
+
 /* inputs to create a hash table with */
 struct hash_inputs {
     struct hash_input * inputs;
     size_t n_inputs;
     size_t capacity;
+
+    /* storage for the keys copied by hash_inputs_add */
+    struct hash_key_chunk * chunks;
+
+    /* keys from hash_inputs_add_no_copy, which are free'd individually */
+    char ** adopted_keys;
+    size_t n_adopted_keys;
+    size_t adopted_keys_capacity;
+
+    /* the fingerprints of the first n_fingerprints inputs, calculated with
+     * fingerprint_seed by hash_inputs_fingerprint. they're kept as long as
+     * the inputs are, including through hash_recycle_inputs, so that keys
+     * only ever need to be fingerprinted once.
+     *
+     * fingerprints_capacity is how many there's room for, or 0 if that isn't
+     * known (e.g. they were handed over from a hash)
+     */
+    uint64_t * fingerprints;
+    size_t n_fingerprints;
+    size_t fingerprints_capacity;
+    uint64_t fingerprint_seed;
+
+    /* the set hash_inputs_add_safe looks for keys in: an open addressing
+     * table, on their fingerprints, of the first n_unique_inputs inputs.
+     * each slot is 0 if empty, or the index of an input plus one. it's
+     * dropped along with the keys.
+     */
+    size_t * unique_slots;
+    size_t n_unique_slots; /* a power of two, or 0 if there's no set */
+    size_t n_unique_inputs;
 #ifdef HASH_STATISTICS
     struct hash_inputs_statistics statistics;
 #endif /* HASH_STATISTICS */
 };
 
+/* the part of a key that hash_lookup compares against: its length, and
+ * either the key itself, null terminated, if it fits, or where it is in the
+ * key_bytes of the hash
+ *
+ * (this is fixed width, and an offset rather than a pointer, so that
+ * hash_save can write the slots as they are)
+ */
+struct hash_key_slot {
+    uint64_t length;
+    union {
+        char bytes[8];
+        uint64_t offset;
+    };
+};
+
+/* keys up to this long are kept in their struct hash_key_slot */
+constexpr size_t hash_key_slot_inline_max =
+    sizeof(((struct hash_key_slot *)NULL)->bytes) - 1;
+
+/* the keys added to a hash by hash_insert since it was last built
+ *
+ * the keys themselves are kept (and fingerprinted) in a struct hash_inputs,
+ * in the order they were inserted, and found through an open addressing
+ * table on their fingerprints
+ */
+struct hash_overflow {
+    struct hash_inputs keys;
+    uint32_t * slots; /* 0 if empty, or the index in keys plus one */
+    size_t n_slots; /* a power of two, at least twice keys.n_inputs */
+    size_t rebuild_at; /* hash_insert rebuilds at this many keys */
+};
+
 /* a hash table */
 struct hash {
+    /* the keys, as they were in the hash_inputs except that keys.inputs is
+     * one allocation holding everything but the adopted keys (see
+     * hash_store_keys)
+     */
     struct hash_inputs keys;
+    const struct hash_key_slot * key_slots;
+    const char * key_bytes; /* the keys too long for their slots */
+    size_t key_bytes_size;
+    size_t keys_size; /* the size of the keys.inputs allocation */
+    enum hash_create_mode mode;
     struct hash_function f1,
                          f2;
-    size_t * values;
+    void * values; /* see hash_values_compact */
     size_t n_values;
+    unsigned int values_bits;
+    bool values_packed;
+    void * tags; /* see hash_tags_create, or NULL */
+    unsigned int tag_bits;
+    bool keys_dropped; /* see hash_drop_keys */
+
+    /* what hash_rebuild makes the hash again with */
+    struct hash_create_options options;
+    struct hash_overflow overflow;
+
+    /* if this hash was loaded by hash_load_mmap, the file it's in. the salt,
+     * values, tags, key slots and key bytes all point into it, and keys.inputs
+     * is filled in by hash_result as keys are found.
+     */
+    void * mapping;
+    size_t mapping_size;
+    const uint64_t * payloads; /* the ptr of each key, from the file */
+
 #ifdef HASH_STATISTICS
     struct hash_statistics statistics;
 #endif /* HASH_STATISTICS */
 };
 
+/*
+ * KEY STORAGE
+ */
+
+/* make sure the newest key chunk of hash_inputs has room for at least n more
+ * bytes
+ *
+ * if it doesn't, a new one is started and whatever was left at the end of the
+ * old one is wasted. chunks double in size (up to hash_key_chunk_size_max) so
+ * that's never much.
+ */
+static void hash_inputs_reserve_key_bytes(
+        struct hash_inputs * hash_inputs, size_t n) [[gnu::nonnull(1)]]
+{
+    struct hash_key_chunk * chunk = hash_inputs->chunks;
+
+    if (!chunk || chunk->capacity - chunk->length < n) {
+        size_t capacity = chunk ? chunk->capacity * 2 : hash_key_chunk_size_min;
+        if (capacity > hash_key_chunk_size_max) {
+            capacity = hash_key_chunk_size_max;
+        }
+        if (capacity < n) {
+            capacity = n;
+        }
+
+        chunk = malloc(sizeof(*chunk) + capacity);
+        *chunk = (struct hash_key_chunk) {
+            .next = hash_inputs->chunks,
+            .capacity = capacity
+        };
+        hash_inputs->chunks = chunk;
+#ifdef HASH_STATISTICS
+        hash_inputs->statistics.n_key_chunks++;
+#endif /* HASH_STATISTICS */
+    }
+}
+
+/* copy this key into the key chunks of hash_inputs, null terminating it, and
+ * return the copy
+ */
+static char * hash_inputs_store_key(
+        struct hash_inputs * hash_inputs,
+        const char * key,
+        size_t length
+    ) [[gnu::nonnull(1, 2)]]
+{
+    hash_inputs_reserve_key_bytes(hash_inputs, length + 1);
+
+    struct hash_key_chunk * chunk = hash_inputs->chunks;
+    char * copy = &chunk->data[chunk->length];
+    memcpy(copy, key, length);
+    copy[length] = '\0';
+    chunk->length += length + 1;
+
+    return copy;
+}
+
+/* take ownership of this key (from hash_inputs_add_no_copy) so it gets
+ * free'd along with hash_inputs
+ */
+static void hash_inputs_adopt_key(
+        struct hash_inputs * hash_inputs, char * key) [[gnu::nonnull(1, 2)]]
+{
+    if (hash_inputs->n_adopted_keys == hash_inputs->adopted_keys_capacity) {
+        hash_inputs->adopted_keys_capacity =
+            hash_inputs->adopted_keys_capacity ?
+                hash_inputs->adopted_keys_capacity * 2 : 16;
+        hash_inputs->adopted_keys = realloc(
+                hash_inputs->adopted_keys,
+                sizeof(*hash_inputs->adopted_keys) *
+                    hash_inputs->adopted_keys_capacity
+            );
+    }
+    hash_inputs->adopted_keys[hash_inputs->n_adopted_keys++] = key;
+}
+
+/* free the key chunks (and fingerprints) of hash_inputs, and if
+ * free_adopted_keys, the keys it took ownership of with hash_inputs_adopt_key
+ */
+static void hash_inputs_free_keys(
+        struct hash_inputs * hash_inputs,
+        bool free_adopted_keys
+    ) [[gnu::nonnull(1)]]
+{
+    struct hash_key_chunk * chunk = hash_inputs->chunks;
+    while (chunk) {
+        struct hash_key_chunk * next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    hash_inputs->chunks = NULL;
+
+    if (free_adopted_keys) {
+        for (size_t i = 0; i < hash_inputs->n_adopted_keys; i++) {
+            free(hash_inputs->adopted_keys[i]);
+        }
+    }
+    free(hash_inputs->adopted_keys);
+    hash_inputs->adopted_keys = NULL;
+    hash_inputs->n_adopted_keys = 0;
+    hash_inputs->adopted_keys_capacity = 0;
+
+    free(hash_inputs->fingerprints);
+    hash_inputs->fingerprints = NULL;
+    hash_inputs->n_fingerprints = 0;
+    hash_inputs->fingerprints_capacity = 0;
+
+    free(hash_inputs->unique_slots);
+    hash_inputs->unique_slots = NULL;
+    hash_inputs->n_unique_slots = 0;
+    hash_inputs->n_unique_inputs = 0;
+}
+
 /*
  * GRAPH
  */
 
+/* the index of a vertex (or of an edge, which is the index of its key)
+ *
+ * 32 bits is plenty and halves the size of everything that holds one
+ */
+typedef uint32_t graph_index;
+
+/* a graph_index that isn't one */
+constexpr graph_index graph_index_none = UINT32_MAX;
+
+/* an edge in the edge list, i.e. the vertices one key hashed to */
+struct graph_edge {
+    graph_index a,
+                b;
+};
+
+/* an entry in the adjacency array: the vertex at the other end of an edge and
+ * the edge (key) it belongs to
+ */
+struct graph_adjacent {
+    graph_index to;
+    graph_index edge;
+};
+
+/* a (vertex, the edge we got there by) pair for the vertex stack */
+struct vertex_stack_node {
+    graph_index vertex;
+    graph_index edge;
+};
+
 /* a graph
+ *
+ * while an attempt is running, the graph is just a flat list of edges (one
+ * per key, in key order) plus a union-find over the vertices that catches
+ * cycles as the edges are added.
+ *
+ * only once an attempt has succeeded does graph_resolve turn the edge list
+ * into a compressed sparse row layout (offsets into a single adjacency array)
+ * and walk it to find the values.
  *
  * because n_vertices only ever goes up, there's no need for a separate
  * capacity value
  */
 struct graph {
-    struct vertex * vertices;
     size_t n_vertices;
+    size_t vertex_capacity; /* how many vertices sets and ranks have room for,
+                             * which can be more than n_vertices when a graph
+                             * is reused (see struct hash_builder)
+                             */
+
+    struct graph_edge * edges;
+    size_t n_edges;
+    size_t edge_capacity;
+
+    /* the union-find */
+    graph_index * sets;
+    unsigned char * ranks;
+
+    /* these are only allocated by graph_resolve (values is handed to the
+     * hash, but the others are kept for the next time, if the graph is
+     * reused)
+     */
+    graph_index * values; /* graph_index_none until resolved */
+    graph_index * offsets;
+    size_t offsets_capacity;
+    struct graph_adjacent * adjacent;
+    size_t adjacent_capacity;
 
     struct vertex_stack_node * vertex_stack;
     size_t vertex_stack_capacity;
@@ -162,257 +492,316 @@ struct graph {
 #endif /* HASH_STATISTICS */
 };
 
-/* a vertex in the above graph */
-struct vertex {
-    hash_function_result value;
-    bool visited;
-    struct edge * edges;
-    size_t n_edges;
-    size_t edge_capacity;
-#ifdef HASH_STATISTICS
-    size_t n_edges_max;
-#endif /* HASH_STATISTICS */
-};
-
-#ifdef HASH_STATISTICS
-constexpr size_t graph_vertex_statistics_extra =
-    sizeof(((struct vertex *)NULL)->n_edges_max);
-#endif /* HASH_STATISTICS */
-
-/* an edge in the above graph */
-struct edge {
-    struct vertex * to;
-    hash_function_result value;
-};
-
-/* a (vertex, parent) pair for the vertext_stack */
-struct vertex_stack_node {
-    struct vertex * vertex, * parent;
-};
-
-/* create a new, empty graph */
-[[nodiscard]] static struct graph * graph_create()
+/* create a new, empty graph with room for edge_capacity edges */
+[[nodiscard]] static struct graph * graph_create(size_t edge_capacity)
 {
     struct graph * graph = malloc(sizeof(*graph));
     *graph = (struct graph) {
-        /* pre-allocate space for a single vertex on the stack */
-        .vertex_stack = malloc(sizeof(*graph->vertex_stack)),
-        .vertex_stack_capacity = 1
+        .edges = malloc(sizeof(*graph->edges) * edge_capacity),
+        .edge_capacity = edge_capacity
     };
 #ifdef HASH_STATISTICS
-    graph->statistics.total_memory_allocated += sizeof(*graph->vertex_stack);
-    graph->statistics.net_memory_allocated += sizeof(*graph->vertex_stack);
+    graph->statistics.total_memory_allocated +=
+        sizeof(*graph->edges) * edge_capacity;
+    graph->statistics.net_memory_allocated +=
+        sizeof(*graph->edges) * edge_capacity;
 #endif /* HASH_STATISTICS */
     return graph;
 }
 
 static void graph_destroy(struct graph * graph) [[gnu::nonnull(1)]]
 {
-    for (size_t i = 0; i < graph->n_vertices; i++) {
-        free(graph->vertices[i].edges);
-    }
-    free(graph->vertices);
+    free(graph->edges);
+    free(graph->sets);
+    free(graph->ranks);
+    free(graph->values);
+    free(graph->offsets);
+    free(graph->adjacent);
     free(graph->vertex_stack);
     free(graph);
 }
 
-/* expand the size of this graph to at least n_vertices, and clear the newly
- * allocated vertices. this does not modify pre-existing vertices except by
- * copying them to newly-allocated memory via realloc.
+/* make this graph n_vertices big, growing its union-find if it has room for
+ * fewer (it never shrinks, so a reused graph only reallocs to grow past the
+ * biggest it's been)
  *
- * note that you still need to call graph_wipe to set the .value property of
- * the each vertex to its proper rest state of -1.
+ * note that you still need to call graph_wipe to reset the union-find
  */
-static void graph_at_least(
+static void graph_resize(
         struct graph * graph, size_t n_vertices) [[gnu::nonnull(1)]]
 {
-    assert(n_vertices >= graph->n_vertices);
-
-#ifdef HASH_STATISTICS
-    graph->statistics.reallocs_vertices++;
-    graph->statistics.realloc_amount_vertices +=
-        (sizeof(*graph->vertices) - graph_vertex_statistics_extra)
-         * graph->n_vertices;
-    graph->statistics.net_memory_allocated +=
-        (sizeof(*graph->vertices) - graph_vertex_statistics_extra)
-         * n_vertices -
-        (sizeof(*graph->vertices) - graph_vertex_statistics_extra)
-         * graph->n_vertices;
-    graph->statistics.total_memory_allocated +=
-        (sizeof(*graph->vertices) - graph_vertex_statistics_extra)
-        * n_vertices;
-#endif /* HASH_STATISTICS */
+    assert(n_vertices < graph_index_none);
 
-    graph->vertices = realloc(
-            graph->vertices, sizeof(*graph->vertices) * n_vertices);
-
-    for (size_t i = graph->n_vertices; i < n_vertices; i++) {
-        graph->vertices[i] = (struct vertex) {
-            /* pre-allocating edges here reduces the number of reallocs,
-             * which are otherwise quite high
-             * (even if only pre-allocating 4 to 12 edges per vertex),
-             * at the expense of using more memory, but ultimately this wasn't
-             * a big immediate performance gain. needs more testing.
-             *
-             * make it a tuneable
-             */
-            .edges = hash_prealloc_edges ?
-                malloc(sizeof(*graph->vertices[i].edges)
-                        * hash_prealloc_edges) : NULL,
-            .edge_capacity = hash_prealloc_edges
-        };
+    if (n_vertices > graph->vertex_capacity) {
 #ifdef HASH_STATISTICS
-        graph->statistics.edges_preallocated += hash_prealloc_edges;
+        graph->statistics.reallocs_vertices++;
+        graph->statistics.realloc_amount_vertices +=
+            (sizeof(*graph->sets) + sizeof(*graph->ranks)) *
+            graph->vertex_capacity;
         graph->statistics.net_memory_allocated +=
-            sizeof(*graph->vertices[i].edges) * hash_prealloc_edges;
+            (sizeof(*graph->sets) + sizeof(*graph->ranks)) *
+            (n_vertices - graph->vertex_capacity);
         graph->statistics.total_memory_allocated +=
-            sizeof(*graph->vertices[i].edges) * hash_prealloc_edges;
+            (sizeof(*graph->sets) + sizeof(*graph->ranks)) * n_vertices;
 #endif /* HASH_STATISTICS */
+
+        graph->sets =
+            realloc(graph->sets, sizeof(*graph->sets) * n_vertices);
+        graph->ranks =
+            realloc(graph->ranks, sizeof(*graph->ranks) * n_vertices);
+        graph->vertex_capacity = n_vertices;
     }
 
     graph->n_vertices = n_vertices;
 }
 
-/* reset the graph, but keep the same number of allocated vertices and the
- * edge_capacity of each vertex. value is reset for each vertex to -1.
+/* make room in this graph for at least edge_capacity edges */
+static void graph_reserve_edges(
+        struct graph * graph, size_t edge_capacity) [[gnu::nonnull(1)]]
+{
+    if (edge_capacity <= graph->edge_capacity) {
+        return;
+    }
+
+#ifdef HASH_STATISTICS
+    graph->statistics.total_memory_allocated +=
+        sizeof(*graph->edges) * edge_capacity;
+    graph->statistics.net_memory_allocated +=
+        sizeof(*graph->edges) * (edge_capacity - graph->edge_capacity);
+#endif /* HASH_STATISTICS */
+
+    graph->edges =
+        realloc(graph->edges, sizeof(*graph->edges) * edge_capacity);
+    graph->edge_capacity = edge_capacity;
+}
+
+/* reset the graph, but keep the same number of allocated vertices. every
+ * edge is removed and each vertex is put back in a set of its own.
  */
 static void graph_wipe(struct graph * graph) [[gnu::nonnull(1)]]
 {
     for (size_t i = 0; i < graph->n_vertices; i++) {
-        graph->vertices[i] = (struct vertex) {
-            .value = -1,
-            .edges = graph->vertices[i].edges,
-#ifdef HASH_STATISTICS
-            .n_edges_max = graph->vertices[i].n_edges_max,
-#endif /* HASH_STATISTICS */
-            .edge_capacity = graph->vertices[i].edge_capacity
-        };
+        graph->sets[i] = i;
+        graph->ranks[i] = 0;
+    }
+    graph->n_edges = 0;
+}
+
+/* find the representative of the set the vertex at index is in, halving the
+ * path to it along the way
+ */
+static graph_index graph_find(
+        struct graph * graph, graph_index index) [[gnu::nonnull(1)]]
+{
+    graph_index * sets = graph->sets;
+    while (sets[index] != index) {
+        sets[index] = sets[sets[index]];
+        index = sets[index];
     }
+    return index;
 }
 
-/* create an edge from the vertex at from_index to the vertex at to_index
- * with this value.
+/* merge the sets containing the vertices at a_index and b_index
  *
- * expands the edge pool if necessary.
+ * returns false (and does nothing) if they are already in the same set,
+ * which means an edge between them would close a cycle
+ */
+static bool graph_union(
+        struct graph * graph,
+        graph_index a_index,
+        graph_index b_index
+    ) [[gnu::nonnull(1)]]
+{
+    graph_index a = graph_find(graph, a_index);
+    graph_index b = graph_find(graph, b_index);
+
+    if (a == b) {
+        return false;
+    }
+
+    if (graph->ranks[a] < graph->ranks[b]) {
+        graph->sets[a] = b;
+    } else if (graph->ranks[a] > graph->ranks[b]) {
+        graph->sets[b] = a;
+    } else {
+        graph->sets[b] = a;
+        graph->ranks[a]++;
+    }
+
+    return true;
+}
+
+/* add an edge between the vertices at a_index and b_index, for the key with
+ * the next index
  */
-static void graph_connect(
+static void graph_add_edge(
         struct graph * graph,
-        size_t from_index,
-        size_t to_index,
-        hash_function_result edge_value
+        graph_index a_index,
+        graph_index b_index
     ) [[gnu::nonnull(1)]]
 {
-    assert(from_index < graph->n_vertices);
-    assert(to_index < graph->n_vertices);
+    assert(a_index < graph->n_vertices);
+    assert(b_index < graph->n_vertices);
+    assert(graph->n_edges < graph->edge_capacity);
 
-    struct vertex * from = &graph->vertices[from_index];
+    graph->edges[graph->n_edges] = (struct graph_edge) {
+        .a = a_index,
+        .b = b_index
+    };
+    graph->n_edges++;
+}
 
-    assert(from->n_edges <= from->edge_capacity);
-    if (from->n_edges == from->edge_capacity) {
+/* build the compressed sparse row adjacency from the edge list: count the
+ * degree of every vertex, turn the counts into offsets, then place each edge
+ * in both of its vertices' ranges
+ */
+static void graph_build_adjacency(struct graph * graph) [[gnu::nonnull(1)]]
+{
+    size_t n_vertices = graph->n_vertices;
 
+    if (graph->offsets_capacity < n_vertices + 1) {
+        free(graph->offsets);
+        graph->offsets = malloc(sizeof(*graph->offsets) * (n_vertices + 1));
+        graph->offsets_capacity = n_vertices + 1;
 #ifdef HASH_STATISTICS
-        graph->statistics.reallocs_edges++;
-        graph->statistics.edges_allocated++;
-        graph->statistics.realloc_amount_edges +=
-            sizeof(*from->edges) * from->edge_capacity;
         graph->statistics.net_memory_allocated +=
-            sizeof(*from->edges) * (from->edge_capacity + 1) -
-            sizeof(*from->edges) * from->edge_capacity;
+            sizeof(*graph->offsets) * (n_vertices + 1);
         graph->statistics.total_memory_allocated +=
-            sizeof(*from->edges) * (from->edge_capacity + 1);
+            sizeof(*graph->offsets) * (n_vertices + 1);
 #endif /* HASH_STATISTICS */
+    }
+    memset(graph->offsets, 0, sizeof(*graph->offsets) * (n_vertices + 1));
 
-        from->edges = realloc(
-                from->edges, sizeof(*from->edges) * (from->edge_capacity + 1));
-        from->edge_capacity += 1;
+    if (graph->adjacent_capacity < 2 * graph->n_edges) {
+        free(graph->adjacent);
+        graph->adjacent =
+            malloc(sizeof(*graph->adjacent) * 2 * graph->n_edges);
+        graph->adjacent_capacity = 2 * graph->n_edges;
+#ifdef HASH_STATISTICS
+        graph->statistics.net_memory_allocated +=
+            sizeof(*graph->adjacent) * 2 * graph->n_edges;
+        graph->statistics.total_memory_allocated +=
+            sizeof(*graph->adjacent) * 2 * graph->n_edges;
+#endif /* HASH_STATISTICS */
     }
 
-#if HASH_PREALLOC_EDGES > 0
-    assert(from->edge_capacity >= hash_prealloc_edges);
-#endif /* HASH_PREALLOC_EDGES */
+#ifdef HASH_STATISTICS
+    graph->statistics.edges_allocated = 2 * graph->n_edges;
+#endif /* HASH_STATISTICS */
 
-    from->edges[from->n_edges] = (struct edge) {
-        .to = &graph->vertices[to_index],
-        .value = edge_value
-    };
-    from->n_edges++;
+    /* offsets[v + 1] counts the degree of v */
+    for (size_t i = 0; i < graph->n_edges; i++) {
+        graph->offsets[graph->edges[i].a + 1]++;
+        graph->offsets[graph->edges[i].b + 1]++;
+    }
 
-#ifdef HASH_STATISTICS
-    if (from->n_edges > from->n_edges_max) {
-        from->n_edges_max = from->n_edges;
+    for (size_t i = 0; i < n_vertices; i++) {
+        graph->offsets[i + 1] += graph->offsets[i];
     }
-#endif /* HASH_STATISTICS */
-}
 
-/* create two edges, one each way, between the vertex at from_index and the
- * vertex at to_index, and give both this value
- */
-static void graph_biconnect(
-        struct graph * graph,
-        size_t from_index,
-        size_t to_index,
-        hash_function_result edge_value
-    ) [[gnu::nonnull(1)]]
-{
-    graph_connect(graph, from_index, to_index, edge_value);
-    graph_connect(graph, to_index, from_index, edge_value);
+    /* borrow sets as the fill cursor for each vertex (the union-find isn't
+     * needed anymore)
+     */
+    graph_index * cursors = graph->sets;
+    for (size_t i = 0; i < n_vertices; i++) {
+        cursors[i] = graph->offsets[i];
+    }
+
+    for (size_t i = 0; i < graph->n_edges; i++) {
+        graph_index a = graph->edges[i].a,
+                    b = graph->edges[i].b;
+        graph->adjacent[cursors[a]++] = (struct graph_adjacent) {
+            .to = b,
+            .edge = i
+        };
+        graph->adjacent[cursors[b]++] = (struct graph_adjacent) {
+            .to = a,
+            .edge = i
+        };
+    }
 }
 
-/* resolve the graph, testing if it is acyclic and generating the appropriate
- * value of each vertex.
+/* resolve the graph, generating the appropriate value of each vertex.
  *
- * returns true if acyclic, false otherwise
+ * the graph must be acyclic, which graph_union makes sure of while it is
+ * being built
  */
-static bool graph_resolve(struct graph * graph)
+static void graph_resolve(struct graph * graph) [[gnu::nonnull(1)]]
 {
+    size_t n_vertices = graph->n_vertices;
+
+    graph_build_adjacency(graph);
+
+    graph->values = malloc(sizeof(*graph->values) * n_vertices);
+    for (size_t i = 0; i < n_vertices; i++) {
+        graph->values[i] = graph_index_none;
+    }
+
+#ifdef HASH_STATISTICS
+    graph->statistics.net_memory_allocated +=
+        sizeof(*graph->values) * n_vertices;
+    graph->statistics.total_memory_allocated +=
+        sizeof(*graph->values) * n_vertices;
+#endif /* HASH_STATISTICS */
+
+    graph_index * values = graph->values;
+    const graph_index * offsets = graph->offsets;
+    const struct graph_adjacent * adjacent = graph->adjacent;
+
     struct vertex_stack_node * vertex_stack = graph->vertex_stack;
     size_t vertex_stack_length;
     size_t vertex_stack_capacity = graph->vertex_stack_capacity;
 
-    for (size_t i = 0; i < graph->n_vertices; i++) {
-        struct vertex * root = &graph->vertices[i];
+    for (size_t i = 0; i < n_vertices; i++) {
+        if (values[i] != graph_index_none) {
+            continue;
+        }
 
-        if (root->visited) {
+        values[i] = 0;
+
+        /* isolated vertices don't need the stack */
+        if (offsets[i] == offsets[i + 1]) {
             continue;
         }
 
-        root->value = 0;
+        if (vertex_stack_capacity == 0) {
+            vertex_stack_capacity = 16;
+            vertex_stack = malloc(
+                    sizeof(*vertex_stack) * vertex_stack_capacity);
+#ifdef HASH_STATISTICS
+            graph->statistics.net_memory_allocated +=
+                sizeof(*vertex_stack) * vertex_stack_capacity;
+            graph->statistics.total_memory_allocated +=
+                sizeof(*vertex_stack) * vertex_stack_capacity;
+#endif /* HASH_STATISTICS */
+        }
 
         vertex_stack[0] = (struct vertex_stack_node) {
-            .vertex = root,
-            .parent = NULL
+            .vertex = i,
+            .edge = graph_index_none
         };
         vertex_stack_length = 1;
 
         while (vertex_stack_length) {
-            struct vertex * vertex =
-                vertex_stack[vertex_stack_length - 1].vertex;
-            struct vertex * parent =
-                vertex_stack[vertex_stack_length - 1].parent;
             vertex_stack_length--;
-
-            vertex->visited = true;
+            graph_index vertex = vertex_stack[vertex_stack_length].vertex;
+            graph_index via = vertex_stack[vertex_stack_length].edge;
 
 #ifdef HASH_STATISTICS
             graph->statistics.nodes_explored++;
 #endif /* HASH_STATISTICS */
 
-            bool skip = true;
-            for (size_t j = 0; j < vertex->n_edges; j++) {
-                struct edge * edge = &vertex->edges[j];
-                struct vertex * to = edge->to;
+            for (graph_index j = offsets[vertex];
+                    j < offsets[vertex + 1]; j++) {
+                graph_index to = adjacent[j].to;
+                graph_index edge = adjacent[j].edge;
 
-                if (skip && to == parent) {
-                    skip = false;
+                if (edge == via) {
                     continue;
                 }
 
-                if (to->visited) {
-                    // cyclic
-                    return false;
-                }
+                assert(values[to] == graph_index_none);
 
-                assert(vertex_stack_length <= vertex_stack_capacity);
                 if (vertex_stack_length == vertex_stack_capacity) {
 
 #ifdef HASH_STATISTICS
@@ -420,480 +809,3745 @@ static bool graph_resolve(struct graph * graph)
                     graph->statistics.realloc_amount_stack +=
                         sizeof(*vertex_stack) * vertex_stack_capacity;
                     graph->statistics.net_memory_allocated +=
-                        sizeof(*vertex_stack) * (vertex_stack_capacity + 1) -
                         sizeof(*vertex_stack) * vertex_stack_capacity;
                     graph->statistics.total_memory_allocated +=
-                        sizeof(*vertex_stack) * (vertex_stack_capacity + 1);
+                        sizeof(*vertex_stack) * vertex_stack_capacity * 2;
 #endif /* HASH_STATISTICS */
 
+                    vertex_stack_capacity *= 2;
                     vertex_stack = realloc(
                             vertex_stack,
-                            sizeof(*vertex_stack) * (vertex_stack_capacity + 1)
+                            sizeof(*vertex_stack) * vertex_stack_capacity
                         );
                     assert(vertex_stack);
-                    vertex_stack_capacity += 1;
-                    graph->vertex_stack = vertex_stack;
-                    graph->vertex_stack_capacity = vertex_stack_capacity;
                 }
                 vertex_stack[vertex_stack_length] =
                     (struct vertex_stack_node) {
                         .vertex = to,
-                        .parent = vertex
+                        .edge = edge
                     };
                 vertex_stack_length++;
 
-                assert((size_t)(hash_function_result)graph->n_vertices ==
-                        graph->n_vertices);
-                hash_function_result v =
-                    (edge->value - vertex->value) %
-                    (hash_function_result)graph->n_vertices;
-
-                if (v < 0) {
-                    v += (hash_function_result)graph->n_vertices;
-                }
-
-                to->value = v;
+                /* values are always < n_vertices, so this can't wrap */
+                values[to] =
+                    (edge + n_vertices - values[vertex]) % n_vertices;
             }
         }
     }
 
-    for (size_t i = 0; i < graph->n_vertices; i++) {
-        assert(graph->vertices[i].value >= 0);
-    }
+    graph->vertex_stack = vertex_stack;
+    graph->vertex_stack_capacity = vertex_stack_capacity;
 
-    // acyclic, all vertex values no longer -1
-    return true;
+    for (size_t i = 0; i < n_vertices; i++) {
+        assert(values[i] < n_vertices);
+    }
 }
 
 /*
  * HASH FUNCTIONS
  */
 
-/* reset this hash function (keeping its buffer and capacity but resetting
- * length and setting a new n)
+/* the random number generator hash_create_ex draws salt and seeds from,
+ * instead of rand(), so that a build shares no state (and takes no lock) with
+ * anything else and gives the same hash on every platform for the same seed
+ *
+ * this is xoshiro256** by Blackman and Vigna, seeded with splitmix64
  */
-static void hash_function_reset(
-        struct hash_function * hash_function, size_t n) [[gnu::nonnull(1)]]
+struct hash_rng {
+    uint64_t s[4];
+};
+
+/* the increment of splitmix64 (2^64 divided by the golden ratio) */
+constexpr uint64_t hash_rng_gamma = 0x9e3779b97f4a7c15ULL;
+
+static inline uint64_t hash_rng_rotl(uint64_t x, int k)
 {
-    hash_function->salt_length = 0;
-    hash_function->n = n;
+    return (x << k) | (x >> (64 - k));
 }
 
-/* apply this hash function to this key of length
+/* seed this generator for attempt number attempt of a search seeded with seed
  *
- * calls rand() if more salt is needed
+ * each attempt starts splitmix64 four steps further along than the one before
+ * it, so no two attempts share a seed, and an attempt's numbers don't depend
+ * on which thread draws them or when
  */
-static hash_function_result hash_function_hash(
-        struct hash_function * hash_function,
-        const char * key,
-        size_t length
+static void hash_rng_init(
+        struct hash_rng * rng,
+        uint64_t seed,
+        size_t attempt
     ) [[gnu::nonnull(1)]]
 {
-    if (hash_function->salt_length < length) {
-        if (hash_function->salt_capacity < length) {
-            hash_function->salt = realloc(
-                    hash_function->salt,
-                    sizeof(*hash_function->salt) * length
-                );
-            hash_function->salt_capacity = length;
-        }
-
-        for (size_t i = hash_function->salt_length; i < length; i++) {
-            hash_function->salt[i] = rand() % hash_function->n;
-        }
-        hash_function->salt_length = length;
-    }
-
-    hash_function_result sum = 0;
-    for (size_t i = 0; i < length; i++) {
-        hash_function_result x =
-            (hash_function_result)(unsigned char)key[i] *
-            (hash_function_result)hash_function->salt[i];
-        assert(x >= 0);
-        assert((sum + x) >= sum);
-        sum += x;
+    uint64_t x = seed + (uint64_t)attempt * 4 * hash_rng_gamma;
+    for (size_t i = 0; i < 4; i++) {
+        x += hash_rng_gamma;
+        uint64_t z = x;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        rng->s[i] = z ^ (z >> 31);
     }
+}
 
-    assert(sum >= 0);
-
-    sum = sum % hash_function->n;
+/* draw the next 64 bits from this generator */
+static inline uint64_t hash_rng_next(struct hash_rng * rng) [[gnu::nonnull(1)]]
+{
+    uint64_t * s = rng->s;
+    uint64_t result = hash_rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = hash_rng_rotl(s[3], 45);
+
+    return result;
+}
 
-    return sum;
+/* draw a number from 0 to n - 1 (for n no more than 2^32) from this generator,
+ * scaling the top 32 bits rather than dividing
+ */
+static inline uint64_t hash_rng_below(
+        struct hash_rng * rng, uint64_t n) [[gnu::nonnull(1)]]
+{
+    assert(n <= (uint64_t)1 << 32);
+    return ((hash_rng_next(rng) >> 32) * n) >> 32;
 }
 
-/* apply this hash function to this key of length
- *
- * will never add salt (if not NDEBUG, triggers an assert instead)
- *
- * use this on a completed hash for lookups (hash_lookup checks lookup length
- * vs the salt_length of the hashes)
+/* reset this hash function (keeping its buffer and capacity but resetting
+ * length and setting a new range of offset to offset + n - 1)
  */
-static hash_function_result hash_function_hash_const(
-        const struct hash_function * hash_function,
-        const char * key,
-        size_t length
+static void hash_function_reset(
+        struct hash_function * hash_function,
+        size_t offset,
+        size_t n
     ) [[gnu::nonnull(1)]]
 {
-    assert(hash_function->salt_length >= length);
+    hash_function->salt_length = 0;
+    hash_function->offset = offset;
+    hash_function->n = n;
+}
 
-    hash_function_result sum = 0;
-    for (size_t i = 0; i < length; i++) {
-        hash_function_result x =
-            (hash_function_result)(unsigned char)key[i] *
-            (hash_function_result)hash_function->salt[i];
-        assert(x >= 0);
-        assert((sum + x) >= sum);
-        sum += x;
+/* make sure this hash function has at least length salt, drawing more from
+ * rng if needed
+ */
+static void hash_function_salt(
+        struct hash_function * hash_function,
+        size_t length,
+        struct hash_rng * rng
+    ) [[gnu::nonnull(1, 3)]]
+{
+    if (hash_function->salt_length >= length) {
+        return;
+    }
+
+    if (hash_function->salt_capacity < length) {
+        hash_function->salt = realloc(
+                hash_function->salt,
+                sizeof(*hash_function->salt) * length
+            );
+        hash_function->salt_capacity = length;
+    }
+
+    for (size_t i = hash_function->salt_length; i < length; i++) {
+        hash_function->salt[i] =
+            (uint32_t)hash_rng_below(rng, hash_function->n);
+    }
+    hash_function->salt_length = length;
+}
+
+/* the salted sums behind hash_function_hash_const and hash_function_hash_pair,
+ * which are picked at runtime from the best set this CPU supports (see
+ * hash_kernels)
+ *
+ * every salt is less than the number of vertices, so it's stored in 32 bits,
+ * and every key byte fits in 8, so each product fits in 40 bits and the vector
+ * kernels can use a 32x32->64 bit multiply. every kernel computes exactly the
+ * same sum, so which one ran never changes the hash.
+ */
+struct hash_kernels {
+    uint64_t (*sum)(const uint32_t * salt, const char * key, size_t length);
+    void (*sum2)(
+            const uint32_t * salt1,
+            const uint32_t * salt2,
+            const char * key,
+            size_t length,
+            uint64_t * sum1,
+            uint64_t * sum2
+        );
+};
+
+static uint64_t hash_sum_scalar(
+        const uint32_t * salt,
+        const char * key,
+        size_t length
+    )
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < length; i++) {
+        sum += (uint64_t)(unsigned char)key[i] * salt[i];
+    }
+    return sum;
+}
+
+static void hash_sum2_scalar(
+        const uint32_t * salt1,
+        const uint32_t * salt2,
+        const char * key,
+        size_t length,
+        uint64_t * sum1,
+        uint64_t * sum2
+    ) [[gnu::nonnull(5, 6)]]
+{
+    uint64_t a = 0, b = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint64_t x = (unsigned char)key[i];
+        a += x * salt1[i];
+        b += x * salt2[i];
+    }
+    *sum1 = a;
+    *sum2 = b;
+}
+
+static const struct hash_kernels hash_kernels_scalar = {
+    .sum = &hash_sum_scalar,
+    .sum2 = &hash_sum2_scalar
+};
+
+#if defined(HASH_X86_KERNELS)
+
+/* SSE4.1: four bytes at a time, widened into two lanes each of two registers
+ */
+[[gnu::target("sse4.1")]]
+static inline __m128i hash_salt_sse41(const uint32_t * salt)
+{
+    return _mm_cvtepu32_epi64(_mm_loadl_epi64((const __m128i *)salt));
+}
+
+[[gnu::target("sse4.1")]]
+static uint64_t hash_sum_sse41(
+        const uint32_t * salt,
+        const char * key,
+        size_t length
+    )
+{
+    __m128i acc_lo = _mm_setzero_si128();
+    __m128i acc_hi = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        uint32_t bytes;
+        memcpy(&bytes, key + i, sizeof(bytes));
+        __m128i x = _mm_cvtsi32_si128((int)bytes);
+        __m128i lo = _mm_cvtepu8_epi64(x);
+        __m128i hi = _mm_cvtepu8_epi64(_mm_srli_si128(x, 2));
+        acc_lo = _mm_add_epi64(acc_lo, _mm_mul_epu32(
+                    lo, hash_salt_sse41(&salt[i])));
+        acc_hi = _mm_add_epi64(acc_hi, _mm_mul_epu32(
+                    hi, hash_salt_sse41(&salt[i + 2])));
+    }
+
+    __m128i acc = _mm_add_epi64(acc_lo, acc_hi);
+    uint64_t sum = (uint64_t)_mm_cvtsi128_si64(acc) +
+        (uint64_t)_mm_extract_epi64(acc, 1);
+
+    for (; i < length; i++) {
+        sum += (uint64_t)(unsigned char)key[i] * salt[i];
+    }
+    return sum;
+}
+
+[[gnu::target("sse4.1")]]
+static void hash_sum2_sse41(
+        const uint32_t * salt1,
+        const uint32_t * salt2,
+        const char * key,
+        size_t length,
+        uint64_t * sum1,
+        uint64_t * sum2
+    ) [[gnu::nonnull(5, 6)]]
+{
+    __m128i acc1 = _mm_setzero_si128();
+    __m128i acc2 = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        uint32_t bytes;
+        memcpy(&bytes, key + i, sizeof(bytes));
+        __m128i x = _mm_cvtsi32_si128((int)bytes);
+        __m128i lo = _mm_cvtepu8_epi64(x);
+        __m128i hi = _mm_cvtepu8_epi64(_mm_srli_si128(x, 2));
+        acc1 = _mm_add_epi64(acc1, _mm_mul_epu32(
+                    lo, hash_salt_sse41(&salt1[i])));
+        acc1 = _mm_add_epi64(acc1, _mm_mul_epu32(
+                    hi, hash_salt_sse41(&salt1[i + 2])));
+        acc2 = _mm_add_epi64(acc2, _mm_mul_epu32(
+                    lo, hash_salt_sse41(&salt2[i])));
+        acc2 = _mm_add_epi64(acc2, _mm_mul_epu32(
+                    hi, hash_salt_sse41(&salt2[i + 2])));
+    }
+
+    uint64_t a = (uint64_t)_mm_cvtsi128_si64(acc1) +
+        (uint64_t)_mm_extract_epi64(acc1, 1);
+    uint64_t b = (uint64_t)_mm_cvtsi128_si64(acc2) +
+        (uint64_t)_mm_extract_epi64(acc2, 1);
+
+    for (; i < length; i++) {
+        uint64_t x = (unsigned char)key[i];
+        a += x * salt1[i];
+        b += x * salt2[i];
+    }
+    *sum1 = a;
+    *sum2 = b;
+}
+
+static const struct hash_kernels hash_kernels_sse41 = {
+    .sum = &hash_sum_sse41,
+    .sum2 = &hash_sum2_sse41
+};
+
+/* AVX2: eight bytes at a time, widened into four lanes each of two registers
+ */
+[[gnu::target("avx2")]]
+static inline __m256i hash_salt_avx2(const uint32_t * salt)
+{
+    return _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)salt));
+}
+
+[[gnu::target("avx2")]]
+static inline uint64_t hash_sum_avx2_reduce(__m256i acc)
+{
+    __m128i x = _mm_add_epi64(
+            _mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    return (uint64_t)_mm_cvtsi128_si64(x) + (uint64_t)_mm_extract_epi64(x, 1);
+}
+
+[[gnu::target("avx2")]]
+static uint64_t hash_sum_avx2(
+        const uint32_t * salt,
+        const char * key,
+        size_t length
+    )
+{
+    __m256i acc_lo = _mm256_setzero_si256();
+    __m256i acc_hi = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t bytes;
+        memcpy(&bytes, key + i, sizeof(bytes));
+        __m128i x = _mm_cvtsi64_si128((long long)bytes);
+        __m256i lo = _mm256_cvtepu8_epi64(x);
+        __m256i hi = _mm256_cvtepu8_epi64(_mm_srli_si128(x, 4));
+        acc_lo = _mm256_add_epi64(acc_lo, _mm256_mul_epu32(
+                    lo, hash_salt_avx2(&salt[i])));
+        acc_hi = _mm256_add_epi64(acc_hi, _mm256_mul_epu32(
+                    hi, hash_salt_avx2(&salt[i + 4])));
+    }
+
+    uint64_t sum = hash_sum_avx2_reduce(_mm256_add_epi64(acc_lo, acc_hi));
+
+    for (; i < length; i++) {
+        sum += (uint64_t)(unsigned char)key[i] * salt[i];
+    }
+    return sum;
+}
+
+[[gnu::target("avx2")]]
+static void hash_sum2_avx2(
+        const uint32_t * salt1,
+        const uint32_t * salt2,
+        const char * key,
+        size_t length,
+        uint64_t * sum1,
+        uint64_t * sum2
+    ) [[gnu::nonnull(5, 6)]]
+{
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t bytes;
+        memcpy(&bytes, key + i, sizeof(bytes));
+        __m128i x = _mm_cvtsi64_si128((long long)bytes);
+        __m256i lo = _mm256_cvtepu8_epi64(x);
+        __m256i hi = _mm256_cvtepu8_epi64(_mm_srli_si128(x, 4));
+        acc1 = _mm256_add_epi64(acc1, _mm256_mul_epu32(
+                    lo, hash_salt_avx2(&salt1[i])));
+        acc1 = _mm256_add_epi64(acc1, _mm256_mul_epu32(
+                    hi, hash_salt_avx2(&salt1[i + 4])));
+        acc2 = _mm256_add_epi64(acc2, _mm256_mul_epu32(
+                    lo, hash_salt_avx2(&salt2[i])));
+        acc2 = _mm256_add_epi64(acc2, _mm256_mul_epu32(
+                    hi, hash_salt_avx2(&salt2[i + 4])));
+    }
+
+    uint64_t a = hash_sum_avx2_reduce(acc1);
+    uint64_t b = hash_sum_avx2_reduce(acc2);
+
+    for (; i < length; i++) {
+        uint64_t x = (unsigned char)key[i];
+        a += x * salt1[i];
+        b += x * salt2[i];
+    }
+    *sum1 = a;
+    *sum2 = b;
+}
+
+static const struct hash_kernels hash_kernels_avx2 = {
+    .sum = &hash_sum_avx2,
+    .sum2 = &hash_sum2_avx2
+};
+
+/* AVX-512: sixteen bytes at a time, widened into eight lanes each of two
+ * registers
+ */
+[[gnu::target("avx512f")]]
+static inline __m512i hash_salt_avx512(const uint32_t * salt)
+{
+    return _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i *)salt));
+}
+
+[[gnu::target("avx512f")]]
+static uint64_t hash_sum_avx512(
+        const uint32_t * salt,
+        const char * key,
+        size_t length
+    )
+{
+    __m512i acc_lo = _mm512_setzero_si512();
+    __m512i acc_hi = _mm512_setzero_si512();
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(key + i));
+        __m512i lo = _mm512_cvtepu8_epi64(x);
+        __m512i hi = _mm512_cvtepu8_epi64(_mm_srli_si128(x, 8));
+        acc_lo = _mm512_add_epi64(acc_lo, _mm512_mul_epu32(
+                    lo, hash_salt_avx512(&salt[i])));
+        acc_hi = _mm512_add_epi64(acc_hi, _mm512_mul_epu32(
+                    hi, hash_salt_avx512(&salt[i + 8])));
+    }
+
+    uint64_t sum = (uint64_t)_mm512_reduce_add_epi64(
+            _mm512_add_epi64(acc_lo, acc_hi));
+
+    for (; i < length; i++) {
+        sum += (uint64_t)(unsigned char)key[i] * salt[i];
+    }
+    return sum;
+}
+
+[[gnu::target("avx512f")]]
+static void hash_sum2_avx512(
+        const uint32_t * salt1,
+        const uint32_t * salt2,
+        const char * key,
+        size_t length,
+        uint64_t * sum1,
+        uint64_t * sum2
+    ) [[gnu::nonnull(5, 6)]]
+{
+    __m512i acc1 = _mm512_setzero_si512();
+    __m512i acc2 = _mm512_setzero_si512();
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(key + i));
+        __m512i lo = _mm512_cvtepu8_epi64(x);
+        __m512i hi = _mm512_cvtepu8_epi64(_mm_srli_si128(x, 8));
+        acc1 = _mm512_add_epi64(acc1, _mm512_mul_epu32(
+                    lo, hash_salt_avx512(&salt1[i])));
+        acc1 = _mm512_add_epi64(acc1, _mm512_mul_epu32(
+                    hi, hash_salt_avx512(&salt1[i + 8])));
+        acc2 = _mm512_add_epi64(acc2, _mm512_mul_epu32(
+                    lo, hash_salt_avx512(&salt2[i])));
+        acc2 = _mm512_add_epi64(acc2, _mm512_mul_epu32(
+                    hi, hash_salt_avx512(&salt2[i + 8])));
+    }
+
+    uint64_t a = (uint64_t)_mm512_reduce_add_epi64(acc1);
+    uint64_t b = (uint64_t)_mm512_reduce_add_epi64(acc2);
+
+    for (; i < length; i++) {
+        uint64_t x = (unsigned char)key[i];
+        a += x * salt1[i];
+        b += x * salt2[i];
+    }
+    *sum1 = a;
+    *sum2 = b;
+}
+
+static const struct hash_kernels hash_kernels_avx512 = {
+    .sum = &hash_sum_avx512,
+    .sum2 = &hash_sum2_avx512
+};
+
+#endif /* HASH_X86_KERNELS */
+
+/* the kernels picked by hash_kernels, or NULL until the first call
+ *
+ * the candidates are all static const, so racing threads that both pick just
+ * store the same pointer and a relaxed load is enough
+ */
+static const struct hash_kernels * _Atomic hash_kernels_selected = NULL;
+
+/* return the best kernels this CPU supports, checking CPUID on the first call
+ *
+ * if hash.c was compiled with HASH_NO_SIMD (or not for x86-64) this is always
+ * the scalar ones
+ */
+static const struct hash_kernels * hash_kernels()
+{
+    const struct hash_kernels * kernels = atomic_load_explicit(
+            &hash_kernels_selected, memory_order_relaxed);
+    if (kernels) {
+        return kernels;
+    }
+
+    kernels = &hash_kernels_scalar;
+#if defined(HASH_X86_KERNELS)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        kernels = &hash_kernels_avx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        kernels = &hash_kernels_avx2;
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        kernels = &hash_kernels_sse41;
+    }
+#endif /* HASH_X86_KERNELS */
+
+    atomic_store_explicit(
+            &hash_kernels_selected, kernels, memory_order_relaxed);
+    return kernels;
+}
+
+/* apply this hash function to this key of length
+ *
+ * will never add salt (if not NDEBUG, triggers an assert instead), so call
+ * hash_function_salt first
+ *
+ * the search and hash_lookup use hash_function_hash_pair instead, so outside
+ * of the (not NDEBUG) checks in hash_create_ex this goes unused
+ */
+[[maybe_unused]]
+static hash_function_result hash_function_hash_const(
+        const struct hash_function * hash_function,
+        const char * key,
+        size_t length
+    ) [[gnu::nonnull(1)]]
+{
+    assert(hash_function->salt_length >= length);
+    assert(hash_function->n <= UINT32_MAX);
+
+    uint64_t sum = hash_kernels()->sum(hash_function->salt, key, length);
+
+    return hash_function->offset + sum % hash_function->n;
+}
+
+/* apply both of these hash functions to this key of length, reading it once
+ *
+ * the same as calling hash_function_hash_const on each, with the same
+ * requirements
+ *
+ * on a completed hash, hash_lookup checks lookup length vs the salt_length of
+ * the hashes before calling this
+ */
+static void hash_function_hash_pair(
+        const struct hash_function * f1,
+        const struct hash_function * f2,
+        const char * key,
+        size_t length,
+        hash_function_result * r1,
+        hash_function_result * r2
+    ) [[gnu::nonnull(1, 2, 5, 6)]]
+{
+    assert(f1->salt_length >= length && f2->salt_length >= length);
+    assert(f1->n <= UINT32_MAX && f2->n <= UINT32_MAX);
+
+    uint64_t sum1, sum2;
+    hash_kernels()->sum2(f1->salt, f2->salt, key, length, &sum1, &sum2);
+
+    *r1 = f1->offset + sum1 % f1->n;
+    *r2 = f2->offset + sum2 % f2->n;
+}
+
+/* draw a new seed for this hash function from rng (for
+ * HASH_CREATE_FINGERPRINT)
+ */
+static void hash_function_seed(
+        struct hash_function * hash_function,
+        struct hash_rng * rng
+    ) [[gnu::nonnull(1, 2)]]
+{
+    hash_function->seed = hash_rng_next(rng);
+}
+
+/* the 64 bit finalizer from MurmurHash3: every bit of x affects every bit of
+ * the result, and it's a bijection
+ */
+static inline uint64_t hash_mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* calculate the 64 bit fingerprint of this key of length with this seed
+ *
+ * the key is read eight bytes at a time, so this costs about length / 8
+ * multiplies rather than the length multiplies of hash_function_hash_const
+ */
+static uint64_t hash_fingerprint(
+        const char * key,
+        size_t length,
+        uint64_t seed
+    ) [[gnu::nonnull(1)]]
+{
+    uint64_t h = seed ^ (length * 0x9e3779b97f4a7c15ULL);
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, &key[i], 8);
+        h ^= hash_mix(word);
+        h = (h << 27 | h >> 37) * 0x9e3779b97f4a7c15ULL;
+    }
+
+    if (i < length) {
+        uint64_t word = 0;
+        memcpy(&word, &key[i], length - i);
+        h ^= hash_mix(word);
+        h = (h << 27 | h >> 37) * 0x9e3779b97f4a7c15ULL;
+    }
+
+    return hash_mix(h);
+}
+
+/* apply this hash function to the fingerprint of a key
+ *
+ * this doesn't look at the key at all, so it costs the same for every key
+ * (use with HASH_CREATE_FINGERPRINT)
+ */
+static hash_function_result hash_function_remix(
+        const struct hash_function * hash_function,
+        uint64_t fingerprint
+    ) [[gnu::nonnull(1)]]
+{
+    uint64_t x = hash_mix(fingerprint ^ hash_function->seed);
+
+    /* map the top 32 bits onto 0 to n - 1 with a multiply instead of a
+     * modulo (n always fits in 32 bits, see graph_index)
+     */
+    assert(hash_function->n <= UINT32_MAX);
+    return hash_function->offset +
+        (hash_function_result)(((x >> 32) * hash_function->n) >> 32);
+}
+
+/* make room for the fingerprints of all the inputs
+ *
+ * there's room made for as many as the inputs have room for, so that
+ * fingerprinting keys one at a time as they're added (as hash_insert and
+ * hash_inputs_add_safe do) doesn't realloc every time
+ */
+static void hash_inputs_fingerprints_reserve(
+        struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]]
+{
+    if (hash_inputs->n_inputs > hash_inputs->fingerprints_capacity) {
+        hash_inputs->fingerprints_capacity =
+            hash_inputs->capacity > hash_inputs->n_inputs ?
+                hash_inputs->capacity : hash_inputs->n_inputs;
+        hash_inputs->fingerprints = realloc(
+                hash_inputs->fingerprints,
+                sizeof(*hash_inputs->fingerprints) *
+                    hash_inputs->fingerprints_capacity
+            );
+    }
+}
+
+/* calculate the fingerprints of any inputs that don't have one yet */
+static void hash_inputs_fingerprint(
+        struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]]
+{
+    if (hash_inputs->n_fingerprints == hash_inputs->n_inputs) {
+        return;
+    }
+
+    hash_inputs_fingerprints_reserve(hash_inputs);
+
+    for (size_t i = hash_inputs->n_fingerprints;
+            i < hash_inputs->n_inputs; i++) {
+        hash_inputs->fingerprints[i] = hash_fingerprint(
+                hash_inputs->inputs[i].key,
+                hash_inputs->inputs[i].length,
+                hash_inputs->fingerprint_seed
+            );
+    }
+
+    hash_inputs->n_fingerprints = hash_inputs->n_inputs;
+}
+
+/*
+ * VALUES
+ */
+
+/* load 64 bits from p, which needn't be aligned, as little endian */
+static inline uint64_t hash_values_load(const unsigned char * p)
+{
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif /* __BYTE_ORDER__ */
+    return x;
+}
+
+/* store 64 bits to p, which needn't be aligned, as little endian */
+static inline void hash_values_store(unsigned char * p, uint64_t x)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif /* __BYTE_ORDER__ */
+    memcpy(p, &x, sizeof(x));
+}
+
+/* the size of a values table of n values of bits bits each, packed or not
+ * (see hash_values_compact)
+ */
+static size_t hash_values_size(size_t n, unsigned int bits, bool packed)
+{
+    if (packed) {
+        return (n * bits + 7) / 8 + sizeof(uint64_t);
+    }
+    return n * (bits / 8);
+}
+
+/* turn the n values of a resolved graph (which this takes) into the values
+ * table of a hash, setting bits and packed to describe it
+ *
+ * every value is less than n, so needs only as many bits as n - 1 does. with
+ * HASH_VALUES_NARROWEST each takes 16 bits if that's enough and otherwise 32
+ * (i.e. a graph_index, so that's the graph's array as-is.) with
+ * HASH_VALUES_PACKED each takes exactly that many bits, with value i starting
+ * at bit i * bits, and the table is padded so hash_value can always load 64
+ * bits at once.
+ */
+static void * hash_values_compact(
+        graph_index * values,
+        size_t n,
+        enum hash_values_layout layout,
+        unsigned int * bits,
+        bool * packed
+    ) [[gnu::nonnull(1, 4, 5)]]
+{
+    unsigned int needed = 1;
+    while (needed < 32 && ((n - 1) >> needed) != 0) {
+        needed++;
+    }
+
+    if (layout == HASH_VALUES_PACKED) {
+        unsigned char * table =
+            calloc(hash_values_size(n, needed, true), 1);
+        for (size_t i = 0; i < n; i++) {
+            size_t bit = i * needed;
+            unsigned char * p = table + bit / 8;
+            hash_values_store(
+                    p, hash_values_load(p) | (uint64_t)values[i] << bit % 8);
+        }
+        free(values);
+        *bits = needed;
+        *packed = true;
+        return table;
+    }
+
+    *packed = false;
+
+    if (needed <= 16) {
+        uint16_t * table = malloc(sizeof(*table) * n);
+        for (size_t i = 0; i < n; i++) {
+            table[i] = (uint16_t)values[i];
+        }
+        free(values);
+        *bits = 16;
+        return table;
+    }
+
+    *bits = 32;
+    return values;
+}
+
+/* the value of vertex i of this hash */
+static inline size_t hash_value(
+        const struct hash * hash, size_t i) [[gnu::nonnull(1)]]
+{
+    if (hash->values_packed) {
+        size_t bit = i * hash->values_bits;
+        uint64_t x = hash_values_load(
+                (const unsigned char *)hash->values + bit / 8);
+        return (x >> bit % 8) & (((uint64_t)1 << hash->values_bits) - 1);
+    } else if (hash->values_bits == 16) {
+        return ((const uint16_t *)hash->values)[i];
+    }
+    return ((const graph_index *)hash->values)[i];
+}
+
+/* the tag of the key with this fingerprint, which is the top bits bits of it
+ * (the remix of hash_function_remix doesn't leave these any less random)
+ */
+static inline uint32_t hash_tag(uint64_t fingerprint, unsigned int bits)
+{
+    assert(bits == 8 || bits == 16 || bits == 32);
+    return (uint32_t)(fingerprint >> (64 - bits));
+}
+
+/* make the tag array of a hash from the fingerprints of its n keys
+ *
+ * tag i is hash_tag of the fingerprint of key i, stored in bits bits, so
+ * hash_lookup can turn away all but about 1 in 2^bits keys that aren't in the
+ * hash without looking at any key
+ */
+static void * hash_tags_create(
+        const uint64_t * fingerprints,
+        size_t n,
+        unsigned int bits
+    ) [[gnu::nonnull(1)]]
+{
+    void * tags = malloc(bits / 8 * n);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t tag = hash_tag(fingerprints[i], bits);
+        if (bits == 8) {
+            ((uint8_t *)tags)[i] = (uint8_t)tag;
+        } else if (bits == 16) {
+            ((uint16_t *)tags)[i] = (uint16_t)tag;
+        } else {
+            ((uint32_t *)tags)[i] = tag;
+        }
+    }
+    return tags;
+}
+
+/* returns true if key i of this hash has the tag of this fingerprint (or if
+ * this hash has no tags)
+ */
+static inline bool hash_tag_matches(
+        const struct hash * hash,
+        size_t i,
+        uint64_t fingerprint
+    ) [[gnu::nonnull(1)]]
+{
+    if (!hash->tags) {
+        return true;
+    }
+
+    uint32_t tag = hash_tag(fingerprint, hash->tag_bits);
+    if (hash->tag_bits == 8) {
+        return ((const uint8_t *)hash->tags)[i] == tag;
+    } else if (hash->tag_bits == 16) {
+        return ((const uint16_t *)hash->tags)[i] == tag;
+    }
+    return ((const uint32_t *)hash->tags)[i] == tag;
+}
+
+/*
+ * THE SEARCH
+ */
+
+/* the scratch memory of the search, kept from one build to the next so that
+ * building again (at about the same size) allocates almost nothing: the
+ * graphs the workers build (with everything graph_resolve allocated for the
+ * last one resolved, but its values, which went to the hash), and the hash
+ * functions whose salt didn't go to a hash
+ *
+ * hash_create_ex uses one of its own for each call. the spare graphs and
+ * functions are taken by workers as a search starts and put back as it ends.
+ */
+struct hash_builder {
+    struct graph ** graphs;
+    size_t n_graphs;
+    size_t graphs_capacity;
+
+    struct hash_function * functions;
+    size_t n_functions;
+    size_t functions_capacity;
+};
+
+/* keep this graph for the next worker to need one */
+static void hash_builder_put_graph(
+        struct hash_builder * builder,
+        struct graph * graph
+    ) [[gnu::nonnull(1, 2)]]
+{
+#ifdef HASH_STATISTICS
+    /* the counters have been counted; what it allocated stays allocated */
+    graph->statistics = (struct hash_statistics) { };
+#endif /* HASH_STATISTICS */
+
+    if (builder->n_graphs == builder->graphs_capacity) {
+        builder->graphs_capacity =
+            builder->graphs_capacity ? builder->graphs_capacity * 2 : 4;
+        builder->graphs = realloc(
+                builder->graphs,
+                sizeof(*builder->graphs) * builder->graphs_capacity
+            );
+    }
+    builder->graphs[builder->n_graphs++] = graph;
+}
+
+/* a spare graph, or NULL if there isn't one */
+static struct graph * hash_builder_take_graph(
+        struct hash_builder * builder) [[gnu::nonnull(1)]]
+{
+    return builder->n_graphs ? builder->graphs[--builder->n_graphs] : NULL;
+}
+
+/* keep this hash function for its salt, if it has any */
+static void hash_builder_put_function(
+        struct hash_builder * builder,
+        struct hash_function hash_function
+    ) [[gnu::nonnull(1)]]
+{
+    if (!hash_function.salt) {
+        return;
+    }
+
+    if (builder->n_functions == builder->functions_capacity) {
+        builder->functions_capacity =
+            builder->functions_capacity ? builder->functions_capacity * 2 : 8;
+        builder->functions = realloc(
+                builder->functions,
+                sizeof(*builder->functions) * builder->functions_capacity
+            );
+    }
+    builder->functions[builder->n_functions++] = hash_function;
+}
+
+/* a spare hash function, or an empty one if there isn't one */
+static struct hash_function hash_builder_take_function(
+        struct hash_builder * builder) [[gnu::nonnull(1)]]
+{
+    return builder->n_functions ?
+        builder->functions[--builder->n_functions] :
+        (struct hash_function) { };
+}
+
+/* free everything builder is keeping (but not builder) */
+static void hash_builder_free_contents(
+        struct hash_builder * builder) [[gnu::nonnull(1)]]
+{
+    for (size_t i = 0; i < builder->n_graphs; i++) {
+        graph_destroy(builder->graphs[i]);
+    }
+    free(builder->graphs);
+    for (size_t i = 0; i < builder->n_functions; i++) {
+        free(builder->functions[i].salt);
+    }
+    free(builder->functions);
+    *builder = (struct hash_builder) { };
+}
+
+/* a slot of the table hash_inputs_find_twins looks for keys in */
+struct hash_twin_slot {
+    uint64_t fingerprint;
+    size_t entry; /* 0 if empty, or the index of a key plus one */
+};
+
+/* look for two keys of hash_inputs that no attempt of the search could tell
+ * apart: the same key twice, or, if fingerprints_only (i.e. only the
+ * fingerprints are hashed), two keys with the same fingerprint. returns false
+ * if there aren't any, or true with the indices of the first two found in
+ * pair, in order.
+ *
+ * this is one pass over the keys with an open addressing table on their
+ * fingerprints, using the ones hash_inputs already has and calculating (but
+ * not keeping) the rest, so it costs less than an attempt and spares the
+ * search from ever having to ask why an attempt failed.
+ */
+static bool hash_inputs_find_twins(
+        const struct hash_inputs * hash_inputs,
+        bool fingerprints_only,
+        size_t pair[2]
+    ) [[gnu::nonnull(1, 3)]]
+{
+    size_t n_inputs = hash_inputs->n_inputs;
+    size_t n_slots = 16;
+    while (n_slots < n_inputs * 2) {
+        n_slots *= 2;
+    }
+    size_t mask = n_slots - 1;
+    struct hash_twin_slot * slots = calloc(n_slots, sizeof(*slots));
+
+    bool found = false;
+    for (size_t i = 0; i < n_inputs && !found; i++) {
+        const struct hash_input * input = &hash_inputs->inputs[i];
+        uint64_t fingerprint = i < hash_inputs->n_fingerprints ?
+            hash_inputs->fingerprints[i] :
+            hash_fingerprint(
+                    input->key, input->length, hash_inputs->fingerprint_seed);
+
+        size_t slot = fingerprint & mask;
+        for (; slots[slot].entry; slot = (slot + 1) & mask) {
+            if (slots[slot].fingerprint != fingerprint) {
+                continue;
+            }
+            const struct hash_input * other =
+                &hash_inputs->inputs[slots[slot].entry - 1];
+            if (fingerprints_only || (other->length == input->length &&
+                        !memcmp(other->key, input->key, input->length))) {
+                pair[0] = slots[slot].entry - 1;
+                pair[1] = i;
+                found = true;
+                break;
+            }
+        }
+        slots[slot] = (struct hash_twin_slot) {
+            .fingerprint = fingerprint,
+            .entry = i + 1
+        };
+    }
+
+    free(slots);
+    return found;
+}
+
+/* the state shared by every worker searching for a hash
+ *
+ * attempts are numbered in the order they are claimed, which is also the order
+ * in which their graph size is decided, and each draws its salt from its own
+ * generator seeded by its number (see hash_rng_init.) the result is always the
+ * lowest-numbered attempt that succeeds, no matter how many workers there are
+ * or which one finishes first, so it is the same hash a single worker would
+ * have found.
+ */
+struct hash_search {
+    const struct hash_inputs * hash_inputs;
+    const struct hash_create_options * options; /* with no zeroes left */
+    struct hash_builder * builder; /* protected by mutex while searching */
+    enum hash_create_mode mode;
+    size_t key_length_max;
+    uint64_t seed;
+
+#if !defined(HASH_NO_THREADS)
+    pthread_mutex_t mutex;
+#endif /* HASH_NO_THREADS */
+
+    /* everything from here down is protected by mutex */
+    size_t next_attempt;
+    size_t n_vertices;
+    size_t n_vertices_scaled;
+    size_t vertices_max;
+    bool exhausted;
+
+    struct graph * winner_graph;
+    struct hash_function winner_f1,
+                         winner_f2;
+
+    /* the number of the winning attempt so far, or SIZE_MAX if there isn't
+     * one yet. this is also read without the mutex by workers checking if
+     * their attempt has already lost
+     */
+    _Atomic size_t winner;
+
+#ifdef HASH_STATISTICS
+    struct hash_statistics statistics;
+#endif /* HASH_STATISTICS */
+};
+
+/* a worker (and the thread it runs on, if it has one) */
+struct hash_worker {
+    struct hash_search * search;
+    struct graph * graph;
+    struct hash_function f1,
+                         f2;
+    size_t attempt;
+    size_t n_vertices;
+#if !defined(HASH_NO_THREADS)
+    pthread_t thread;
+#endif /* HASH_NO_THREADS */
+};
+
+/* workers check if they've lost every this many keys */
+constexpr size_t hash_search_cancel_check_interval = 1024;
+
+static void hash_search_lock(struct hash_search * search) [[gnu::nonnull(1)]]
+{
+#if !defined(HASH_NO_THREADS)
+    pthread_mutex_lock(&search->mutex);
+#else
+    (void)search;
+#endif /* HASH_NO_THREADS */
+}
+
+static void hash_search_unlock(struct hash_search * search) [[gnu::nonnull(1)]]
+{
+#if !defined(HASH_NO_THREADS)
+    pthread_mutex_unlock(&search->mutex);
+#else
+    (void)search;
+#endif /* HASH_NO_THREADS */
+}
+
+#ifdef HASH_STATISTICS
+/* add the counters (but not the sizes) from this graph's statistics to the
+ * search's statistics. call with the mutex held.
+ */
+static void hash_search_count(
+        struct hash_search * search,
+        const struct graph * graph
+    ) [[gnu::nonnull(1, 2)]]
+{
+    search->statistics.iterations += graph->statistics.iterations;
+    search->statistics.nodes_explored += graph->statistics.nodes_explored;
+    search->statistics.hashes_calculated +=
+        graph->statistics.hashes_calculated;
+}
+#endif /* HASH_STATISTICS */
+
+/* claim the next attempt for this worker, setting its size (the worker draws
+ * its salt afterwards, without the mutex)
+ *
+ * returns false if there are no attempts left that could beat the winner
+ */
+static bool hash_search_claim(
+        struct hash_search * search,
+        struct hash_worker * worker
+    ) [[gnu::nonnull(1, 2)]]
+{
+    bool claimed = false;
+
+    hash_search_lock(search);
+
+    if (search->exhausted || search->next_attempt >= search->winner) {
+        goto done;
+    }
+
+    size_t attempt = search->next_attempt;
+
+    const struct hash_create_options * options = search->options;
+    if (attempt > 0 &&
+            attempt % options->iterations_grow_every_n_trials == 0) {
+        // time to grow the size of the graph
+        search->n_vertices_scaled *= options->iterations_growth_multiplier;
+        search->n_vertices_scaled /=
+            options->iterations_growth_multiplier_divider;
+
+        size_t n_vertices_next =
+            search->n_vertices_scaled /
+            options->iterations_growth_multiplier_divider;
+
+        if (n_vertices_next > search->n_vertices) {
+            search->n_vertices = n_vertices_next;
+        }
+
+        if (search->n_vertices >= search->vertices_max) {
+            search->exhausted = true;
+            goto done;
+        }
+    }
+
+    search->next_attempt++;
+
+    worker->attempt = attempt;
+    worker->n_vertices = search->n_vertices;
+
+    if (hash_split_vertices) {
+        size_t half = search->n_vertices / 2;
+        hash_function_reset(&worker->f1, 0, half);
+        hash_function_reset(&worker->f2, half, search->n_vertices - half);
+    } else {
+        hash_function_reset(&worker->f1, 0, search->n_vertices);
+        hash_function_reset(&worker->f2, 0, search->n_vertices);
+    }
+
+    claimed = true;
+
+#ifdef HASH_STATISTICS
+    if (search->mode == HASH_CREATE_FINGERPRINT) {
+        search->statistics.rand_calls += 2;
+        goto done;
+    }
+
+    if (search->key_length_max > worker->f1.salt_capacity) {
+        search->statistics.reallocs_salt += 2;
+        search->statistics.realloc_amount_salt +=
+            2 * sizeof(*worker->f1.salt) * search->key_length_max;
+        search->statistics.net_memory_allocated +=
+            2 * sizeof(*worker->f1.salt) *
+            (search->key_length_max - worker->f1.salt_capacity);
+        search->statistics.total_memory_allocated +=
+            2 * sizeof(*worker->f1.salt) * search->key_length_max;
+    }
+    search->statistics.rand_calls += 2 * search->key_length_max;
+#endif /* HASH_STATISTICS */
+
+done:
+    hash_search_unlock(search);
+    return claimed;
+}
+
+/* hand the graph and hash functions of this worker's successful attempt to
+ * the search, if it beats the current winner
+ */
+static void hash_search_publish(
+        struct hash_search * search,
+        struct hash_worker * worker
+    ) [[gnu::nonnull(1, 2)]]
+{
+    struct graph * loser_graph = NULL;
+    struct hash_function loser_f1 = {},
+                         loser_f2 = {};
+
+    hash_search_lock(search);
+    if (worker->attempt < search->winner) {
+        loser_graph = search->winner_graph;
+        loser_f1 = search->winner_f1;
+        loser_f2 = search->winner_f2;
+
+        search->winner_graph = worker->graph;
+        search->winner_f1 = worker->f1;
+        search->winner_f2 = worker->f2;
+        search->winner = worker->attempt;
+
+        worker->graph = NULL;
+        worker->f1 = (struct hash_function) { };
+        worker->f2 = (struct hash_function) { };
+    }
+    if (loser_graph) {
+#ifdef HASH_STATISTICS
+        hash_search_count(search, loser_graph);
+#endif /* HASH_STATISTICS */
+        hash_builder_put_graph(search->builder, loser_graph);
+    }
+    hash_builder_put_function(search->builder, loser_f1);
+    hash_builder_put_function(search->builder, loser_f2);
+    hash_search_unlock(search);
+}
+
+/* the worker loop: claim attempts and try them until there aren't any left
+ * that could win
+ */
+static void * hash_worker_run(void * data) [[gnu::nonnull(1)]]
+{
+    struct hash_worker * worker = data;
+    struct hash_search * search = worker->search;
+    const struct hash_inputs * hash_inputs = search->hash_inputs;
+    size_t n_keys = hash_inputs->n_inputs;
+
+    while (hash_search_claim(search, worker)) {
+        struct hash_rng rng;
+        hash_rng_init(&rng, search->seed, worker->attempt);
+        if (search->mode == HASH_CREATE_FINGERPRINT) {
+            hash_function_seed(&worker->f1, &rng);
+            hash_function_seed(&worker->f2, &rng);
+        } else {
+            hash_function_salt(&worker->f1, search->key_length_max, &rng);
+            hash_function_salt(&worker->f2, search->key_length_max, &rng);
+        }
+
+        if (!worker->graph) {
+            worker->graph = graph_create(n_keys);
+        }
+
+        struct graph * graph = worker->graph;
+
+        /* (a spare graph may have been built for fewer keys, or more) */
+        graph_reserve_edges(graph, n_keys);
+        if (worker->n_vertices != graph->n_vertices) {
+            graph_resize(graph, worker->n_vertices);
+        }
+
+#ifdef HASH_STATISTICS
+        graph->statistics.graph_size = worker->n_vertices;
+        graph->statistics.iterations++;
+#endif /* HASH_STATISTICS */
+
+        graph_wipe(graph);
+
+        bool failed = false;
+        for (size_t i = 0; i < n_keys; i++) {
+            if (i % hash_search_cancel_check_interval == 0 &&
+                    atomic_load_explicit(
+                        &search->winner, memory_order_relaxed) <
+                    worker->attempt) {
+                failed = true;
+                break;
+            }
+
+#ifdef HASH_STATISTICS
+            graph->statistics.hashes_calculated += 2;
+#endif /* HASH_STATISTICS */
+
+            hash_function_result r1, r2;
+            if (search->mode == HASH_CREATE_FINGERPRINT) {
+                uint64_t fingerprint = hash_inputs->fingerprints[i];
+                r1 = hash_function_remix(&worker->f1, fingerprint);
+                r2 = hash_function_remix(&worker->f2, fingerprint);
+            } else {
+                const char * key = hash_inputs->inputs[i].key;
+                size_t length = hash_inputs->inputs[i].length;
+                hash_function_hash_pair(
+                        &worker->f1, &worker->f2, key, length, &r1, &r2);
+            }
+
+            if (!graph_union(graph, r1, r2)) {
+                // cyclic
+                failed = true;
+                break;
+            }
+
+            graph_add_edge(graph, r1, r2);
+        }
+
+#ifdef HASH_SIMULATE_WORST_CASE
+        /* make it think it's doing work */
+        (void)failed;
+#else
+        if (!failed) {
+            hash_search_publish(search, worker);
+        }
+#endif /* HASH_SIMULATE_WORST_CASE */
+    }
+
+    return NULL;
+}
+
+/* run the search on n_threads workers (the calling thread among them) until
+ * there are no attempts left that could win
+ */
+static void hash_search_run(
+        struct hash_search * search, size_t n_threads) [[gnu::nonnull(1)]]
+{
+    struct hash_worker * workers = malloc(sizeof(*workers) * n_threads);
+    for (size_t i = 0; i < n_threads; i++) {
+        workers[i] = (struct hash_worker) {
+            .search = search,
+            .graph = hash_builder_take_graph(search->builder),
+            .f1 = hash_builder_take_function(search->builder),
+            .f2 = hash_builder_take_function(search->builder)
+        };
+    }
+
+    /* the calling thread is always worker 0 */
+#if !defined(HASH_NO_THREADS)
+    size_t n_started = 1;
+    for (size_t i = 1; i < n_threads; i++) {
+        if (pthread_create(
+                    &workers[i].thread, NULL, hash_worker_run, &workers[i])) {
+#if !defined(HASH_NO_WARNINGS)
+            fprintf(
+                    stderr,
+                    "WARNING: hash_create_ex() could only start %zu of %zu threads\n",
+                    n_started,
+                    n_threads
+                );
+#endif /* HASH_NO_WARNINGS */
+            break;
+        }
+        n_started++;
+    }
+#endif /* HASH_NO_THREADS */
+
+    hash_worker_run(&workers[0]);
+
+#if !defined(HASH_NO_THREADS)
+    for (size_t i = 1; i < n_started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+#endif /* HASH_NO_THREADS */
+
+    for (size_t i = 0; i < n_threads; i++) {
+        if (workers[i].graph) {
+#ifdef HASH_STATISTICS
+            hash_search_count(search, workers[i].graph);
+#endif /* HASH_STATISTICS */
+            hash_builder_put_graph(search->builder, workers[i].graph);
+        }
+        hash_builder_put_function(search->builder, workers[i].f1);
+        hash_builder_put_function(search->builder, workers[i].f2);
+    }
+    free(workers);
+}
+
+/*
+ * THE OVERFLOW
+ */
+
+/* an empty overflow for a hash of n_keys keys fingerprinted with this seed,
+ * made with these options (with no zeroes left)
+ */
+static struct hash_overflow hash_overflow_create(
+        size_t n_keys,
+        uint64_t fingerprint_seed,
+        const struct hash_create_options * options
+    ) [[gnu::nonnull(3)]]
+{
+    size_t rebuild_at = n_keys / options->overflow_rebuild_divisor;
+    return (struct hash_overflow) {
+        .keys = {
+            .fingerprint_seed = fingerprint_seed
+        },
+        .rebuild_at = rebuild_at > options->overflow_rebuild_min ?
+            rebuild_at : options->overflow_rebuild_min
+    };
+}
+
+/* the index in overflow of this key of length with this fingerprint, or
+ * SIZE_MAX if it isn't there
+ */
+static size_t hash_overflow_find(
+        const struct hash_overflow * overflow,
+        const char * key,
+        size_t length,
+        uint64_t fingerprint
+    ) [[gnu::nonnull(1, 2)]]
+{
+    if (!overflow->keys.n_inputs) {
+        return SIZE_MAX;
+    }
+
+    size_t mask = overflow->n_slots - 1;
+    for (size_t slot = fingerprint & mask; ; slot = (slot + 1) & mask) {
+        uint32_t entry = overflow->slots[slot];
+        if (!entry) {
+            return SIZE_MAX;
+        }
+        const struct hash_input * input = &overflow->keys.inputs[entry - 1];
+        if (overflow->keys.fingerprints[entry - 1] == fingerprint &&
+                input->length == length &&
+                !memcmp(input->key, key, length)) {
+            return entry - 1;
+        }
+    }
+}
+
+/* put key i of overflow, with this fingerprint, into its slot */
+static void hash_overflow_place(
+        struct hash_overflow * overflow,
+        size_t i,
+        uint64_t fingerprint
+    ) [[gnu::nonnull(1)]]
+{
+    size_t mask = overflow->n_slots - 1;
+    size_t slot = fingerprint & mask;
+    while (overflow->slots[slot]) {
+        slot = (slot + 1) & mask;
+    }
+    overflow->slots[slot] = i + 1;
+}
+
+/* add this key of length (which must not be in overflow yet) to overflow,
+ * associating it with ptr
+ */
+static void hash_overflow_add(
+        struct hash_overflow * overflow,
+        const char * key,
+        size_t length,
+        void * ptr
+    ) [[gnu::nonnull(1, 2)]]
+{
+    hash_inputs_add(&overflow->keys, key, length, ptr);
+    hash_inputs_fingerprint(&overflow->keys);
+
+    size_t n_keys = overflow->keys.n_inputs;
+    if (n_keys * 2 > overflow->n_slots) {
+        free(overflow->slots);
+        overflow->n_slots = overflow->n_slots ? overflow->n_slots * 2 : 16;
+        overflow->slots = calloc(overflow->n_slots, sizeof(*overflow->slots));
+        for (size_t i = 0; i + 1 < n_keys; i++) {
+            hash_overflow_place(overflow, i, overflow->keys.fingerprints[i]);
+        }
+    }
+    hash_overflow_place(
+            overflow, n_keys - 1, overflow->keys.fingerprints[n_keys - 1]);
+}
+
+/* free everything in overflow */
+static void hash_overflow_destroy(
+        struct hash_overflow * overflow) [[gnu::nonnull(1)]]
+{
+    hash_inputs_free_keys(&overflow->keys, true);
+    free(overflow->keys.inputs);
+    free(overflow->slots);
+}
+
+/*
+ * THE HASH TABLE
+ */
+
+/* compare two key pointers by address, for qsort and bsearch */
+static int hash_compare_key_pointers(const void * a, const void * b)
+{
+    uintptr_t x = (uintptr_t)*(char * const *)a;
+    uintptr_t y = (uintptr_t)*(char * const *)b;
+    return (x > y) - (x < y);
+}
+
+/* move the keys of hash_inputs into hash, leaving hash_inputs empty
+ *
+ * the keys are repacked into one allocation, in order of their index: first
+ * the array of struct hash_input that hash_lookup and hash_get_keys hand out,
+ * then a struct hash_key_slot for each, then the bytes of every key too long
+ * to fit in its slot, each null terminated. a hit then reads the slot (and
+ * for long keys, the bytes after it) rather than chasing a pointer into
+ * whichever chunk the key was added to, and free'ing the keys is one free.
+ *
+ * keys from hash_inputs_add_no_copy are still handed out as themselves, since
+ * they're the caller's, and are kept (along with the fingerprints) in
+ * hash->keys as they were in hash_inputs. they're copied into the slots and
+ * key bytes all the same, so that every key is compared the same way.
+ */
+static void hash_store_keys(
+        struct hash * hash,
+        struct hash_inputs * hash_inputs
+    ) [[gnu::nonnull(1, 2)]]
+{
+    size_t n_keys = hash_inputs->n_inputs;
+    const struct hash_input * inputs = hash_inputs->inputs;
+
+    /* sorted, so an adopted key can be told apart in log time */
+    char ** adopted = NULL;
+    size_t n_adopted = hash_inputs->n_adopted_keys;
+    if (n_adopted) {
+        adopted = malloc(sizeof(*adopted) * n_adopted);
+        memcpy(adopted, hash_inputs->adopted_keys,
+                sizeof(*adopted) * n_adopted);
+        qsort(adopted, n_adopted, sizeof(*adopted),
+                hash_compare_key_pointers);
+    }
+
+    size_t key_bytes_size = 0;
+    for (size_t i = 0; i < n_keys; i++) {
+        if (inputs[i].length > hash_key_slot_inline_max) {
+            key_bytes_size += inputs[i].length + 1;
+        }
+    }
+
+    size_t size = (sizeof(struct hash_input) + sizeof(struct hash_key_slot)) *
+        n_keys + key_bytes_size;
+    struct hash_input * keys = malloc(size);
+    struct hash_key_slot * slots = (struct hash_key_slot *)&keys[n_keys];
+    char * key_bytes = (char *)&slots[n_keys];
+    size_t offset = 0;
+
+    for (size_t i = 0; i < n_keys; i++) {
+        const struct hash_input * input = &inputs[i];
+        struct hash_key_slot * slot = &slots[i];
+        char * key;
+
+        *slot = (struct hash_key_slot) {
+            .length = input->length
+        };
+
+        if (input->length <= hash_key_slot_inline_max) {
+            key = slot->bytes;
+        } else {
+            key = &key_bytes[offset];
+            key[input->length] = '\0';
+            slot->offset = offset;
+            offset += input->length + 1;
+        }
+        memcpy(key, input->key, input->length);
+
+        if (n_adopted && bsearch(
+                    &input->key, adopted, n_adopted, sizeof(*adopted),
+                    hash_compare_key_pointers)) {
+            key = input->key;
+        }
+
+        keys[i] = (struct hash_input) {
+            .key = key,
+            .length = input->length,
+            .ptr = input->ptr
+        };
+    }
+    free(adopted);
+
+#ifdef HASH_STATISTICS
+    hash->statistics.total_memory_allocated += size;
+    hash->statistics.net_memory_allocated += size;
+#endif /* HASH_STATISTICS */
+
+    /* the adopted keys and fingerprints come along as they are */
+    hash->keys = (struct hash_inputs) {
+        .inputs = keys,
+        .n_inputs = n_keys,
+        .capacity = n_keys,
+        .adopted_keys = hash_inputs->adopted_keys,
+        .n_adopted_keys = hash_inputs->n_adopted_keys,
+        .adopted_keys_capacity = hash_inputs->adopted_keys_capacity,
+        .fingerprints = hash_inputs->fingerprints,
+        .n_fingerprints = hash_inputs->n_fingerprints,
+        .fingerprint_seed = hash_inputs->fingerprint_seed
+    };
+    hash->key_slots = slots;
+    hash->key_bytes = key_bytes;
+    hash->key_bytes_size = key_bytes_size;
+    hash->keys_size = size;
+
+    hash_inputs->adopted_keys = NULL;
+    hash_inputs->n_adopted_keys = 0;
+    hash_inputs->adopted_keys_capacity = 0;
+    hash_inputs->fingerprints = NULL;
+    hash_inputs->n_fingerprints = 0;
+    hash_inputs->fingerprints_capacity = 0;
+    hash_inputs_free_keys(hash_inputs, false);
+    free(hash_inputs->inputs);
+    *hash_inputs = (struct hash_inputs) { };
+}
+
+/* take the keys out of hash_inputs like hash_store_keys does, but throw them
+ * away, keeping only how many there were (for hash_create_ex with
+ * drop_keys)
+ *
+ * the hash then has no key slots, key bytes, or results, and its keys.inputs
+ * is NULL. lookups can only go by index, and everything that hands out keys
+ * hands out none.
+ */
+static void hash_drop_keys(
+        struct hash * hash,
+        struct hash_inputs * hash_inputs
+    ) [[gnu::nonnull(1, 2)]]
+{
+    hash->keys = (struct hash_inputs) {
+        .n_inputs = hash_inputs->n_inputs,
+        .fingerprint_seed = hash_inputs->fingerprint_seed
+    };
+    hash->keys_dropped = true;
+
+    hash_inputs_free_keys(hash_inputs, true);
+    free(hash_inputs->inputs);
+    *hash_inputs = (struct hash_inputs) { };
+}
+
+/* returns true if key i of hash was copied into it (i.e. wasn't adopted from
+ * hash_inputs_add_no_copy)
+ */
+static bool hash_stores_key(
+        const struct hash * hash, size_t i) [[gnu::nonnull(1)]]
+{
+    if (hash->mapping) {
+        return true;
+    }
+
+    uintptr_t key = (uintptr_t)hash->keys.inputs[i].key;
+    uintptr_t start = (uintptr_t)hash->keys.inputs;
+    return key >= start && key < start + hash->keys_size;
+}
+
+/* what keys.inputs[i].key of a hash loaded by hash_load_mmap is while
+ * hash_result is filling it in
+ */
+static char hash_result_busy;
+
+/* wait a little for a result that another thread is filling in, having
+ * already waited spins times
+ */
+static void hash_result_wait(size_t spins)
+{
+#if !defined(_WIN32)
+    if (spins >= hash_result_spins_max) {
+        sched_yield();
+        return;
+    }
+#else
+    (void)spins;
+#endif /* _WIN32 */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    __asm__ volatile ("yield");
+#endif
+}
+
+/* return key i of this hash as a lookup result
+ *
+ * for a hash loaded by hash_load_mmap, the result is filled in from the file
+ * the first time it's needed. whoever gets to swap its key from NULL to
+ * &hash_result_busy fills it in, and anyone else who finds it busy waits
+ * until it isn't.
+ */
+static const struct hash_lookup_result * hash_result(
+        const struct hash * hash, size_t i) [[gnu::nonnull(1)]]
+{
+    struct hash_input * result = &hash->keys.inputs[i];
+
+    if (!hash->mapping) {
+        return (const struct hash_lookup_result *)result;
+    }
+
+    char * key = __atomic_load_n(&result->key, __ATOMIC_ACQUIRE);
+    if (key && key != &hash_result_busy) {
+        return (const struct hash_lookup_result *)result;
+    }
+
+    if (!key && __atomic_compare_exchange_n(
+                &result->key, &key, &hash_result_busy, false,
+                __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        const struct hash_key_slot * slot = &hash->key_slots[i];
+        const char * stored = slot->length <= hash_key_slot_inline_max ?
+            slot->bytes : &hash->key_bytes[slot->offset];
+        result->length = slot->length;
+        result->ptr = (void *)(uintptr_t)hash->payloads[i];
+        __atomic_store_n(&result->key, (char *)stored, __ATOMIC_RELEASE);
+        return (const struct hash_lookup_result *)result;
+    }
+
+    /* someone else is filling it in, which is only a few stores */
+    for (size_t spins = 0; __atomic_load_n(&result->key, __ATOMIC_ACQUIRE) ==
+            &hash_result_busy; spins++) {
+        hash_result_wait(spins);
+    }
+    return (const struct hash_lookup_result *)result;
+}
+
+/* make sure every key of this hash has its result, for the functions that
+ * hand them all out at once
+ */
+static void hash_results_fill(const struct hash * hash) [[gnu::nonnull(1)]]
+{
+    if (!hash->mapping || hash->keys_dropped) {
+        return;
+    }
+
+    for (size_t i = 0; i < hash->keys.n_inputs; i++) {
+        hash_result(hash, i);
+    }
+}
+
+/* record in status (if it isn't NULL) that hash_create_ex failed this way */
+static void hash_create_fail(
+        struct hash_create_status * status,
+        enum hash_create_outcome outcome
+    )
+{
+    if (status) {
+        status->outcome = outcome;
+    }
+}
+
+/* these options (which may be NULL) with every field that's 0 for its
+ * default (see TUNING VALUES) set to that default
+ */
+static struct hash_create_options hash_create_options_resolve(
+        const struct hash_create_options * options)
+{
+    struct hash_create_options resolved =
+        options ? *options : (struct hash_create_options) { };
+
+    if (!resolved.n_threads) {
+        resolved.n_threads = 1;
+    }
+    if (!resolved.vertices_per_key_multiplier) {
+        resolved.vertices_per_key_multiplier =
+            hash_vertices_per_key_multiplier;
+    }
+    if (!resolved.vertices_per_key_divider) {
+        resolved.vertices_per_key_divider = hash_vertices_per_key_divider;
+    }
+    if (!resolved.iterations_max_multiplier) {
+        resolved.iterations_max_multiplier = hash_iterations_max_multiplier;
+    }
+    if (!resolved.iterations_grow_every_n_trials) {
+        resolved.iterations_grow_every_n_trials =
+            hash_iterations_grow_every_n_trials;
+    }
+    if (!resolved.iterations_growth_multiplier) {
+        resolved.iterations_growth_multiplier =
+            hash_iterations_growth_multiplier;
+    }
+    if (!resolved.iterations_growth_multiplier_divider) {
+        resolved.iterations_growth_multiplier_divider =
+            hash_iterations_growth_multiplier_divider;
+    }
+    if (!resolved.overflow_rebuild_min) {
+        resolved.overflow_rebuild_min = hash_overflow_rebuild_min;
+    }
+    if (!resolved.overflow_rebuild_divisor) {
+        resolved.overflow_rebuild_divisor = hash_overflow_rebuild_divisor;
+    }
+
+    return resolved;
+}
+
+/* calculate a hash table for all the elements in hash_inputs
+ *
+ * this can fail. if it does, this function returns null. (hash_create_ex can
+ * say why, through hash_create_options.status.)
+ *
+ * to change how the parameter-space is searched before giving up, see the
+ * tuning options of hash_create_ex() (struct hash_create_options).
+ *
+ * calculation is deterministic: it draws from its own random number generator
+ * seeded with 0 (see hash_create_ex to pick another seed) and never calls
+ * rand().
+ *
+ * if this returns non-null, the keys will have been removed from hash_inputs.
+ * it still needs to be free'd.
+ *
+ * if you want the inputs back, see hash_recycle_inputs, hash_get_inputs, and
+ * hash_inputs_from_hash.
+ */
+[[nodiscard]] struct hash * hash_create(
+        struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]]
+{
+    return hash_create_ex(hash_inputs, NULL);
+}
+
+/* see hash_create
+ *
+ * with n_threads > 1, that many workers try attempts at the same time. the
+ * first worker to find a solution cancels any attempts that come after it.
+ * because each attempt's salt depends only on the seed and the attempt's
+ * number (see struct hash_search), the hash table is the same for the same
+ * seed regardless of n_threads.
+ */
+[[nodiscard]] struct hash * hash_create_ex(
+        struct hash_inputs * hash_inputs,
+        const struct hash_create_options * options
+    ) [[gnu::nonnull(1)]]
+{
+    struct hash_builder builder = { };
+    struct hash * hash = hash_builder_build(&builder, hash_inputs, options);
+    hash_builder_free_contents(&builder);
+    return hash;
+}
+
+/* create a hash_builder, which has no scratch memory until it's first used */
+[[nodiscard]] struct hash_builder * hash_builder_create()
+{
+    struct hash_builder * builder = malloc(sizeof(*builder));
+    *builder = (struct hash_builder) { };
+    return builder;
+}
+
+/* destroy a hash_builder and the scratch memory it's kept */
+void hash_builder_destroy(
+        struct hash_builder * builder) [[gnu::nonnull(1)]]
+{
+    hash_builder_free_contents(builder);
+    free(builder);
+}
+
+/* see hash_create_ex
+ *
+ * the graphs and salts the search needs are taken from builder, if it has
+ * them from an earlier build, and given back to it afterwards, along with
+ * the graph of the winning attempt (whose resolving scratch space is kept
+ * too). the winner's salts and values become the hash's.
+ */
+[[nodiscard]] struct hash * hash_builder_build(
+        struct hash_builder * builder,
+        struct hash_inputs * hash_inputs,
+        const struct hash_create_options * options
+    ) [[gnu::nonnull(1, 2)]]
+{
+    size_t n_keys = hash_inputs->n_inputs;
+
+    /* only this call writes to it, so the hash doesn't keep it */
+    struct hash_create_status * status = options ? options->status : NULL;
+    if (status) {
+        *status = (struct hash_create_status) { };
+    }
+
+    if (n_keys == 0) {
+        hash_create_fail(status, HASH_CREATE_FAILED_NO_KEYS);
+        return NULL;
+    }
+
+    struct hash_create_options resolved = hash_create_options_resolve(options);
+    resolved.status = NULL;
+
+    size_t n_threads = resolved.n_threads;
+#if defined(HASH_NO_THREADS)
+    if (n_threads > 1) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_create_ex() was asked for %zu threads but hash.c was compiled with HASH_NO_THREADS\n",
+                n_threads
+            );
+#endif /* HASH_NO_WARNINGS */
+        n_threads = 1;
+        resolved.n_threads = 1;
+    }
+#endif /* HASH_NO_THREADS */
+
+    enum hash_create_mode mode = resolved.mode;
+    enum hash_values_layout values_layout = resolved.values_layout;
+    unsigned int tag_bits = resolved.tag_bits;
+    bool drop_keys = resolved.drop_keys;
+
+    /* the graph has to grow for the search to ever end */
+    if (resolved.iterations_growth_multiplier <=
+            resolved.iterations_growth_multiplier_divider) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_create_ex() was given a growth multiplier (%zu / %zu) that doesn't grow the graph\n",
+                resolved.iterations_growth_multiplier,
+                resolved.iterations_growth_multiplier_divider
+            );
+#endif /* HASH_NO_WARNINGS */
+        hash_create_fail(status, HASH_CREATE_FAILED_BAD_OPTIONS);
+        return NULL;
+    }
+
+    if (tag_bits != 0 && tag_bits != 8 && tag_bits != 16 && tag_bits != 32) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_create_ex() was asked for %u bit tags, which isn't 0, 8, 16, or 32\n",
+                tag_bits
+            );
+#endif /* HASH_NO_WARNINGS */
+        hash_create_fail(status, HASH_CREATE_FAILED_BAD_OPTIONS);
+        return NULL;
+    }
+
+    /* tags come from the fingerprints too */
+#ifdef HASH_STATISTICS
+    size_t n_fingerprinted = 0;
+#endif /* HASH_STATISTICS */
+    if (mode == HASH_CREATE_FINGERPRINT || tag_bits) {
+#ifdef HASH_STATISTICS
+        n_fingerprinted = n_keys - hash_inputs->n_fingerprints;
+#endif /* HASH_STATISTICS */
+        hash_inputs_fingerprint(hash_inputs);
+    }
+
+    size_t key_length_max = 0;
+    if (mode != HASH_CREATE_FINGERPRINT) {
+        for (size_t i = 0; i < n_keys; i++) {
+            if (hash_inputs->inputs[i].length > key_length_max) {
+                key_length_max = hash_inputs->inputs[i].length;
+            }
+        }
+    }
+
+    /* at least 2, so each half has a vertex when splitting */
+    size_t n_vertices =
+        (n_keys * resolved.vertices_per_key_multiplier +
+         resolved.vertices_per_key_divider - 1) /
+        resolved.vertices_per_key_divider;
+    if (n_vertices < 2) {
+        n_vertices = 2;
+    }
+
+    /* vertices are indexed with a graph_index */
+    if (n_vertices >= graph_index_none) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_create() was called with too many keys (%zu)\n",
+                n_keys
+            );
+#endif /* HASH_NO_WARNINGS */
+        hash_create_fail(status, HASH_CREATE_FAILED_TOO_MANY_KEYS);
+        return NULL;
+    }
+
+    /* a multiplier below the starting size would be passed before the first
+     * attempt, so it's clamped to the starting size: the graph gets its
+     * first iterations_grow_every_n_trials attempts and never grows
+     */
+    size_t vertices_max = resolved.iterations_max_multiplier * n_keys;
+    if (vertices_max < n_vertices) {
+        vertices_max = n_vertices;
+    }
+    if (vertices_max > graph_index_none) {
+        vertices_max = graph_index_none;
+    }
+
+    /* the same key twice fails every attempt, and so do distinct keys with
+     * the same fingerprint when only the fingerprints are hashed. those just
+     * need fingerprinting again with another seed, until none collide.
+     */
+#ifdef HASH_STATISTICS
+    n_fingerprinted += n_keys - hash_inputs->n_fingerprints;
+#endif /* HASH_STATISTICS */
+    size_t twins[2];
+    while (hash_inputs_find_twins(
+                hash_inputs, mode == HASH_CREATE_FINGERPRINT, twins)) {
+        const struct hash_input * twin = &hash_inputs->inputs[twins[1]];
+        if (hash_inputs->inputs[twins[0]].length == twin->length &&
+                !memcmp(hash_inputs->inputs[twins[0]].key, twin->key,
+                    twin->length)) {
+#if !defined(HASH_NO_WARNINGS)
+            fprintf(
+                    stderr,
+                    "WARNING: hash_create() was given the same key twice (keys %zu and %zu)\n",
+                    twins[0],
+                    twins[1]
+                );
+#endif /* HASH_NO_WARNINGS */
+            if (status) {
+                status->duplicates[0] = twins[0];
+                status->duplicates[1] = twins[1];
+            }
+            hash_create_fail(status, HASH_CREATE_FAILED_DUPLICATE_KEYS);
+            return NULL;
+        }
+
+        hash_inputs->fingerprint_seed++;
+        hash_inputs->n_fingerprints = 0;
+        hash_inputs_fingerprint(hash_inputs);
+#ifdef HASH_STATISTICS
+        n_fingerprinted += n_keys;
+#endif /* HASH_STATISTICS */
+    }
+
+    struct hash_search search = {
+        .hash_inputs = hash_inputs,
+        .options = &resolved,
+        .builder = builder,
+        .mode = mode,
+        .key_length_max = key_length_max,
+        .seed = resolved.seed,
+        .n_vertices = n_vertices,
+        .n_vertices_scaled =
+            n_vertices * resolved.iterations_growth_multiplier_divider,
+        .vertices_max = vertices_max,
+        .winner = SIZE_MAX
+    };
+#if !defined(HASH_NO_THREADS)
+    pthread_mutex_init(&search.mutex, NULL);
+#endif /* HASH_NO_THREADS */
+
+    hash_search_run(&search, n_threads);
+
+#if !defined(HASH_NO_THREADS)
+    pthread_mutex_destroy(&search.mutex);
+#endif /* HASH_NO_THREADS */
+
+    if (status) {
+        status->attempts = search.next_attempt;
+    }
+
+    if (!search.winner_graph) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_create() ran for more than size * hash_iteration_max_multiplier iterations (%zu) without a solution\n",
+                search.next_attempt
+            );
+#endif /* HASH_NO_WARNINGS */
+        hash_create_fail(status, HASH_CREATE_FAILED_NO_SOLUTION);
+        return NULL;
+    }
+
+    struct graph * graph = search.winner_graph;
+    struct hash_function f1 = search.winner_f1,
+                         f2 = search.winner_f2;
+
+    /* only the winning graph ever needs its values */
+    graph_resolve(graph);
+
+#ifndef NDEBUG
+    for (size_t i = 0; i < n_keys; i++) {
+        const char * key = hash_inputs->inputs[i].key;
+        size_t length = hash_inputs->inputs[i].length;
+        hash_function_result r1, r2;
+        if (mode == HASH_CREATE_FINGERPRINT) {
+            uint64_t fingerprint = hash_fingerprint(
+                    key, length, hash_inputs->fingerprint_seed);
+            assert(fingerprint == hash_inputs->fingerprints[i]);
+            r1 = hash_function_remix(&f1, fingerprint);
+            r2 = hash_function_remix(&f2, fingerprint);
+        } else {
+            r1 = hash_function_hash_const(&f1, key, length);
+            r2 = hash_function_hash_const(&f2, key, length);
+        }
+        size_t v = (graph->values[r1] + graph->values[r2]) % graph->n_vertices;
+        assert(i == v);
+    }
+#endif /* NDEBUG */
+
+#ifdef HASH_STATISTICS
+    size_t degree_min = graph->offsets[1] - graph->offsets[0];
+    size_t degree_max = degree_min;
+    for (size_t i = 0; i < graph->n_vertices; i++) {
+        size_t degree = graph->offsets[i + 1] - graph->offsets[i];
+        if (degree < degree_min) {
+            degree_min = degree;
+        }
+        if (degree > degree_max) {
+            degree_max = degree;
+        }
+    }
+    graph->statistics.degree_min = degree_min;
+    graph->statistics.degree_max = degree_max;
+
+    graph->statistics.vertex_stack_capacity = graph->vertex_stack_capacity;
+
+    graph->statistics.total_memory_allocated +=
+        sizeof(*graph) - sizeof(struct hash_statistics);
+    graph->statistics.net_memory_allocated +=
+        sizeof(*graph) - sizeof(struct hash_statistics);
+
+    /* the winner's own counters are folded in here, the rest were folded in
+     * as their graphs were destroyed
+     */
+    hash_search_count(&search, graph);
+    graph->statistics.iterations = search.statistics.iterations;
+    graph->statistics.nodes_explored = search.statistics.nodes_explored;
+    graph->statistics.hashes_calculated = search.statistics.hashes_calculated;
+    graph->statistics.rand_calls = search.statistics.rand_calls;
+    graph->statistics.reallocs_salt = search.statistics.reallocs_salt;
+    graph->statistics.realloc_amount_salt =
+        search.statistics.realloc_amount_salt;
+    graph->statistics.net_memory_allocated +=
+        search.statistics.net_memory_allocated;
+    graph->statistics.total_memory_allocated +=
+        search.statistics.total_memory_allocated;
+
+    assert(f1.salt_length == f2.salt_length);
+    graph->statistics.key_length_max = f1.salt_length;
+    graph->statistics.fingerprints_calculated = n_fingerprinted;
+#endif /* HASH_STATISTICS */
+
+    struct hash * hash = malloc(sizeof(*hash));
+    *hash = (struct hash) {
+        .mode = mode,
+        .f1 = f1,
+        .f2 = f2,
+        .n_values = graph->n_vertices
+    };
+    hash->values = hash_values_compact(
+            graph->values,
+            graph->n_vertices,
+            values_layout,
+            &hash->values_bits,
+            &hash->values_packed
+        );
+    graph->values = NULL;
+
+#ifdef HASH_STATISTICS
+    hash->statistics = graph->statistics;
+    hash->statistics.value_bits = hash->values_bits;
+#endif /* HASH_STATISTICS */
+
+    if (tag_bits) {
+        hash->tags =
+            hash_tags_create(hash_inputs->fingerprints, n_keys, tag_bits);
+        hash->tag_bits = tag_bits;
+#ifdef HASH_STATISTICS
+        hash->statistics.total_memory_allocated += tag_bits / 8 * n_keys;
+        hash->statistics.net_memory_allocated += tag_bits / 8 * n_keys;
+#endif /* HASH_STATISTICS */
+    }
+
+    if (drop_keys) {
+        hash_drop_keys(hash, hash_inputs);
+    } else {
+        hash_store_keys(hash, hash_inputs);
+    }
+
+    hash->options = resolved;
+    hash->overflow = hash_overflow_create(
+            n_keys, hash->keys.fingerprint_seed, &hash->options);
+
+    hash_builder_put_graph(builder, graph);
+
+    return hash;
+}
+
+/* free everything this hash table has, but not the struct hash itself */
+static void hash_free_contents(struct hash * hash) [[gnu::nonnull(1)]]
+{
+    if (hash->mapping) {
+#if defined(_WIN32)
+        free(hash->mapping);
+#else
+        munmap(hash->mapping, hash->mapping_size);
+#endif /* _WIN32 */
+    } else {
+        free(hash->f1.salt);
+        free(hash->f2.salt);
+        free(hash->values);
+        free(hash->tags);
+    }
+    hash_inputs_free_keys(&hash->keys, true);
+    free(hash->keys.inputs);
+    hash_overflow_destroy(&hash->overflow);
+}
+
+/* destroy this hash table */
+void hash_destroy(struct hash * hash) [[gnu::nonnull(1)]]
+{
+    hash_free_contents(hash);
+    free(hash);
+}
+
+/* returns the number of keys in this hash, including any from hash_insert */
+size_t hash_n_keys(const struct hash * hash) [[gnu::nonnull(1)]]
+{
+    return hash->keys.n_inputs + hash->overflow.keys.n_inputs;
+}
+
+/* destroy this hash table, but extract the hash_inputs it was created with
+ * first and return it for modification and reuse
+ *
+ * this is a new hash_inputs and needs to be free'd separely from the one
+ * passed to hash_create. moreover, free'ing that hash_inputs has no effect
+ * on the use or results of this function
+ */
+struct hash_inputs * hash_recycle_inputs(
+        struct hash * hash) [[gnu::nonnull(1)]]
+{
+    struct hash_inputs * inputs = hash_inputs_create();
+    size_t n_keys = hash->keys_dropped ? 0 : hash->keys.n_inputs;
+    const struct hash_inputs * inserted = &hash->overflow.keys;
+
+    hash_results_fill(hash);
+
+    /* the copied keys go back into key chunks, and adopted keys are adopted
+     * again, so the keys and fingerprints end up where they'd be if they'd
+     * been added to inputs in the first place
+     */
+    hash_inputs_at_least(inputs, n_keys + inserted->n_inputs);
+    for (size_t i = 0; i < n_keys; i++) {
+        struct hash_input * input = &hash->keys.inputs[i];
+        if (hash_stores_key(hash, i)) {
+            hash_inputs_add(inputs, input->key, input->length, input->ptr);
+        } else {
+            hash_inputs_add_no_copy(
+                    inputs, input->key, input->length, input->ptr);
+        }
+    }
+    for (size_t i = 0; i < inserted->n_inputs; i++) {
+        const struct hash_input * input = &inserted->inputs[i];
+        hash_inputs_add(inputs, input->key, input->length, input->ptr);
+    }
+
+    inputs->fingerprints = hash->keys.fingerprints;
+    inputs->n_fingerprints = hash->keys.n_fingerprints;
+    inputs->fingerprint_seed = hash->keys.fingerprint_seed;
+    hash->keys.fingerprints = NULL;
+    hash->keys.n_fingerprints = 0;
+    hash->keys.fingerprints_capacity = 0;
+
+    /* inputs has its own list of them now */
+    hash->keys.n_adopted_keys = 0;
+
+    hash_destroy(hash);
+    return inputs;
+}
+
+/* returns a pointer to the keys inside this hash table and, if n_keys_out
+ * is non-NULL, sets it to the number of keys
+ *
+ * (not counting keys from hash_insert since the last build, which aren't in
+ * the same array)
+ */
+const struct hash_lookup_result * hash_get_keys(
+        const struct hash * hash, size_t * n_keys_out) [[gnu::nonnull(1)]]
+{
+    if (n_keys_out) {
+        *n_keys_out = hash->keys_dropped ? 0 : hash->keys.n_inputs;
+    }
+    hash_results_fill(hash);
+    return (struct hash_lookup_result *)hash->keys.inputs;
+}
+
+/* apply this function over every key this hash was created with */
+void hash_apply(
+        const struct hash * hash,
+        void (*fn)(
+            const char * key, size_t length, void * data, void * ptr),
+        void * ptr
+    ) [[gnu::nonnull(1, 2)]]
+{
+    if (hash->keys_dropped) {
+        return;
+    }
+    hash_results_fill(hash);
+    hash_inputs_apply(&hash->keys, fn, ptr);
+    hash_inputs_apply(&hash->overflow.keys, fn, ptr);
+}
+
+/* the first step of a lookup: find the two vertices this key of length maps
+ * to, and its fingerprint if this hash needs one
+ *
+ * returns false if the key can't be in this hash at all
+ */
+static inline bool hash_lookup_locate(
+        const struct hash * hash,
+        const char * key,
+        size_t length,
+        hash_function_result * r1,
+        hash_function_result * r2,
+        uint64_t * fingerprint
+    ) [[gnu::nonnull(1, 2, 4, 5, 6)]]
+{
+    assert(hash->f2.offset + hash->f2.n == hash->n_values);
+    assert(hash->f1.salt_length == hash->f2.salt_length);
+
+    *fingerprint = 0;
+    if (hash->mode == HASH_CREATE_FINGERPRINT || hash->tags) {
+        *fingerprint =
+            hash_fingerprint(key, length, hash->keys.fingerprint_seed);
+    }
+
+    if (hash->mode == HASH_CREATE_FINGERPRINT) {
+        *r1 = hash_function_remix(&hash->f1, *fingerprint);
+        *r2 = hash_function_remix(&hash->f2, *fingerprint);
+        return true;
+    }
+
+    if (length > hash->f1.salt_length) {
+        return false;
+    }
+
+    hash_function_hash_pair(&hash->f1, &hash->f2, key, length, r1, r2);
+    return true;
+}
+
+/* the second step of a lookup: the index of the only key that could be at
+ * vertices r1 and r2, or SIZE_MAX if there isn't one
+ */
+static inline size_t hash_lookup_resolve(
+        const struct hash * hash,
+        hash_function_result r1,
+        hash_function_result r2
+    ) [[gnu::nonnull(1)]]
+{
+    size_t i = (hash_value(hash, r1) + hash_value(hash, r2)) % hash->n_values;
+
+    if (i >= hash->keys.n_inputs) {
+        return SIZE_MAX;
+    }
+    return i;
+}
+
+/* the last step of a lookup: returns true if key i of this hash is this key
+ * of length with this fingerprint
+ *
+ * a hash without keys can only check the tag
+ */
+static inline bool hash_lookup_matches(
+        const struct hash * hash,
+        size_t i,
+        const char * key,
+        size_t length,
+        uint64_t fingerprint
+    ) [[gnu::nonnull(1, 3)]]
+{
+    if (!hash_tag_matches(hash, i, fingerprint)) {
+        return false;
+    }
+
+    if (hash->keys_dropped) {
+        return true;
+    }
+
+    const struct hash_key_slot * slot = &hash->key_slots[i];
+
+    if (slot->length != length) {
+        return false;
+    }
+
+    const char * stored =
+        length <= hash_key_slot_inline_max ?
+            slot->bytes : &hash->key_bytes[slot->offset];
+    return memcmp(stored, key, length) == 0;
+}
+
+/* returns key i of this hash if it is this key of length with this
+ * fingerprint, and NULL otherwise
+ */
+static inline const struct hash_lookup_result * hash_lookup_compare(
+        const struct hash * hash,
+        size_t i,
+        const char * key,
+        size_t length,
+        uint64_t fingerprint
+    ) [[gnu::nonnull(1, 3)]]
+{
+    if (!hash_lookup_matches(hash, i, key, length, fingerprint)) {
+        return NULL;
+    }
+    return hash_result(hash, i);
+}
+
+/* for a key that isn't in the hash table proper: the index in the overflow
+ * of this key of length, or SIZE_MAX if it isn't there either
+ */
+static inline size_t hash_lookup_inserted(
+        const struct hash * hash,
+        const char * key,
+        size_t length
+    ) [[gnu::nonnull(1, 2)]]
+{
+    const struct hash_overflow * overflow = &hash->overflow;
+    if (!overflow->keys.n_inputs) {
+        return SIZE_MAX;
+    }
+    return hash_overflow_find(
+            overflow, key, length,
+            hash_fingerprint(key, length, overflow->keys.fingerprint_seed));
+}
+
+/* look up this key of length n in this hash and return a const pointer to the
+ * result if found or NULL otherwise
+ */
+const struct hash_lookup_result * hash_lookup(
+        const struct hash * hash,
+        const char * key,
+        size_t length
+    ) [[gnu::nonnull(1, 2)]]
+{
+    if (hash->keys_dropped) {
+        return NULL;
+    }
+
+    hash_function_result r1, r2;
+    uint64_t fingerprint;
+    if (hash_lookup_locate(hash, key, length, &r1, &r2, &fingerprint)) {
+        size_t i = hash_lookup_resolve(hash, r1, r2);
+        const struct hash_lookup_result * result = i == SIZE_MAX ? NULL :
+            hash_lookup_compare(hash, i, key, length, fingerprint);
+        if (result) {
+            return result;
+        }
+    }
+
+    size_t i = hash_lookup_inserted(hash, key, length);
+    if (i == SIZE_MAX) {
+        return NULL;
+    }
+    return (const struct hash_lookup_result *)&hash->overflow.keys.inputs[i];
+}
+
+/* look up this key of length in this hash and return its index (the order
+ * it was added in), or SIZE_MAX if it isn't in this hash
+ *
+ * this is hash_lookup without handing out the result, so on a hash made with
+ * drop_keys it only checks the tag (if there is one)
+ */
+size_t hash_lookup_index(
+        const struct hash * hash,
+        const char * key,
+        size_t length
+    ) [[gnu::nonnull(1, 2)]]
+{
+    hash_function_result r1, r2;
+    uint64_t fingerprint;
+    if (hash_lookup_locate(hash, key, length, &r1, &r2, &fingerprint)) {
+        size_t i = hash_lookup_resolve(hash, r1, r2);
+        if (i != SIZE_MAX &&
+                hash_lookup_matches(hash, i, key, length, fingerprint)) {
+            return i;
+        }
+    }
+
+    /* inserted keys come after the rest, in the order they were inserted,
+     * which is where the next build will put them
+     */
+    size_t i = hash_lookup_inserted(hash, key, length);
+    if (i == SIZE_MAX) {
+        return SIZE_MAX;
+    }
+    return hash->keys.n_inputs + i;
+}
+
+/* return the index of this key of length, which must be in this hash (and
+ * not added by hash_insert since the last build)
+ *
+ * this hashes the key and reads two values, and nothing else: no tags, no
+ * keys. for a key that isn't in this hash, it returns either SIZE_MAX or the
+ * index of some other key.
+ */
+size_t hash_lookup_index_unchecked(
+        const struct hash * hash,
+        const char * key,
+        size_t length
+    ) [[gnu::nonnull(1, 2)]]
+{
+    hash_function_result r1, r2;
+
+    if (hash->mode == HASH_CREATE_FINGERPRINT) {
+        uint64_t fingerprint =
+            hash_fingerprint(key, length, hash->keys.fingerprint_seed);
+        r1 = hash_function_remix(&hash->f1, fingerprint);
+        r2 = hash_function_remix(&hash->f2, fingerprint);
+    } else if (length > hash->f1.salt_length) {
+        return SIZE_MAX;
+    } else {
+        hash_function_hash_pair(&hash->f1, &hash->f2, key, length, &r1, &r2);
+    }
+
+    return hash_lookup_resolve(hash, r1, r2);
+}
+
+/* look up n keys at once, setting results[j] to what hash_lookup would return
+ * for keys[j] of length lengths[j]
+ *
+ * the keys are taken hash_lookup_batch_group at a time, and each step of the
+ * lookup is done for the whole group before the next, prefetching what the
+ * next step will read. so rather than each key waiting on its own cache
+ * misses one after another, the misses of the whole group overlap.
+ */
+void hash_lookup_batch(
+        const struct hash * hash,
+        const char * const * keys,
+        const size_t * lengths,
+        const struct hash_lookup_result ** results,
+        size_t n
+    ) [[gnu::nonnull(1, 2, 3, 4)]]
+{
+    hash_function_result r1[hash_lookup_batch_group],
+                         r2[hash_lookup_batch_group];
+    uint64_t fingerprints[hash_lookup_batch_group];
+    size_t indices[hash_lookup_batch_group];
+
+    const unsigned char * values = hash->values;
+
+    if (hash->keys_dropped) {
+        for (size_t j = 0; j < n; j++) {
+            results[j] = NULL;
+        }
+        return;
+    }
+
+    for (size_t start = 0; start < n; start += hash_lookup_batch_group) {
+        size_t group = n - start < hash_lookup_batch_group ?
+            n - start : hash_lookup_batch_group;
+        const char * const * group_keys = &keys[start];
+        const size_t * group_lengths = &lengths[start];
+        const struct hash_lookup_result ** group_results = &results[start];
+
+        /* hash, and prefetch the values (each values_bits wide, packed or
+         * not)
+         */
+        for (size_t j = 0; j < group; j++) {
+            if (!hash_lookup_locate(
+                        hash, group_keys[j], group_lengths[j],
+                        &r1[j], &r2[j], &fingerprints[j])) {
+                indices[j] = SIZE_MAX;
+                continue;
+            }
+            indices[j] = 0;
+            __builtin_prefetch(
+                    values + (size_t)r1[j] * hash->values_bits / 8);
+            __builtin_prefetch(
+                    values + (size_t)r2[j] * hash->values_bits / 8);
+        }
+
+        /* find the indices, and prefetch the tags, slots, and results */
+        for (size_t j = 0; j < group; j++) {
+            if (indices[j] == SIZE_MAX) {
+                continue;
+            }
+            size_t i = hash_lookup_resolve(hash, r1[j], r2[j]);
+            indices[j] = i;
+            if (i == SIZE_MAX) {
+                continue;
+            }
+            if (hash->tags) {
+                __builtin_prefetch(
+                        (const unsigned char *)hash->tags +
+                        i * (hash->tag_bits / 8));
+            }
+            __builtin_prefetch(&hash->key_slots[i]);
+            __builtin_prefetch(&hash->keys.inputs[i]);
+        }
+
+        /* prefetch the keys that don't fit in their slots */
+        for (size_t j = 0; j < group; j++) {
+            size_t i = indices[j];
+            if (i != SIZE_MAX &&
+                    hash->key_slots[i].length > hash_key_slot_inline_max &&
+                    hash->key_slots[i].length == group_lengths[j]) {
+                __builtin_prefetch(
+                        &hash->key_bytes[hash->key_slots[i].offset]);
+            }
+        }
+
+        /* compare, and look for the misses among the inserted keys */
+        for (size_t j = 0; j < group; j++) {
+            size_t i = indices[j];
+            group_results[j] = i == SIZE_MAX ? NULL : hash_lookup_compare(
+                    hash, i, group_keys[j], group_lengths[j],
+                    fingerprints[j]);
+            if (!group_results[j] && hash->overflow.keys.n_inputs) {
+                i = hash_lookup_inserted(
+                        hash, group_keys[j], group_lengths[j]);
+                if (i != SIZE_MAX) {
+                    group_results[j] = (const struct hash_lookup_result *)
+                        &hash->overflow.keys.inputs[i];
+                }
+            }
+        }
+    }
+}
+
+/* a new hash_inputs holding a copy of every key of this hash (including
+ * the ones from hash_insert), with room for extra more, and their
+ * fingerprints if it has them
+ *
+ * unlike hash_recycle_inputs, this leaves the hash as it was
+ */
+static struct hash_inputs * hash_inputs_copy_keys(
+        const struct hash * hash, size_t extra) [[gnu::nonnull(1)]]
+{
+    const struct hash_inputs * inserted = &hash->overflow.keys;
+    size_t n_keys = hash->keys.n_inputs;
+    size_t n_total = n_keys + inserted->n_inputs;
+
+    struct hash_inputs * inputs = hash_inputs_create();
+    hash_inputs_at_least(inputs, n_total + extra);
+    hash_results_fill(hash);
+    for (size_t i = 0; i < n_keys; i++) {
+        const struct hash_input * input = &hash->keys.inputs[i];
+        hash_inputs_add(inputs, input->key, input->length, input->ptr);
+    }
+    for (size_t i = 0; i < inserted->n_inputs; i++) {
+        const struct hash_input * input = &inserted->inputs[i];
+        hash_inputs_add(inputs, input->key, input->length, input->ptr);
+    }
+
+    /* every inserted key has its fingerprint, so if the rest do too they
+     * all come along
+     */
+    inputs->fingerprint_seed = hash->keys.fingerprint_seed;
+    if (hash->keys.n_fingerprints == n_keys &&
+            inserted->fingerprint_seed == hash->keys.fingerprint_seed) {
+        inputs->fingerprints = malloc(sizeof(*inputs->fingerprints) * n_total);
+        memcpy(inputs->fingerprints, hash->keys.fingerprints,
+                sizeof(*inputs->fingerprints) * n_keys);
+        if (inserted->n_inputs) {
+            memcpy(&inputs->fingerprints[n_keys], inserted->fingerprints,
+                    sizeof(*inputs->fingerprints) * inserted->n_inputs);
+        }
+        inputs->n_fingerprints = n_total;
+    }
+
+    return inputs;
+}
+
+/* make this hash again from scratch with all its keys, including the ones
+ * from hash_insert, and the options it was made with
+ *
+ * returns false (and if not HASH_NO_WARNINGS, prints why) if it can't, in
+ * which case the hash is as it was
+ */
+bool hash_rebuild(struct hash * hash) [[gnu::nonnull(1)]]
+{
+    if (hash->keys_dropped) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_rebuild() called on a hash without keys\n"
+            );
+#endif /* HASH_NO_WARNINGS */
+        return false;
+    }
+
+    /* a copy, so that if this fails nothing has changed */
+    struct hash_inputs * inputs = hash_inputs_copy_keys(hash, 0);
+    struct hash * rebuilt = hash_create_ex(inputs, &hash->options);
+    hash_inputs_destroy(inputs);
+
+    if (!rebuilt) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_rebuild() couldn't create a hash of %zu keys\n",
+                hash_n_keys(hash)
+            );
+#endif /* HASH_NO_WARNINGS */
+        return false;
+    }
+
+    hash_free_contents(hash);
+    *hash = *rebuilt;
+    free(rebuilt);
+    return true;
+}
+
+/* add this key of length to this hash, associating it with ptr
+ *
+ * the key goes into the overflow until there are enough of them for
+ * hash_rebuild to be worth it (see hash_overflow_rebuild_min)
+ *
+ * returns false if the key can't be added: if it's already in the hash, if
+ * it's zero-length, or if the hash has no keys
+ */
+bool hash_insert(
+        struct hash * hash,
+        const char * key,
+        size_t length,
+        void * ptr
+    ) [[gnu::nonnull(1, 2)]]
+{
+    if (hash->keys_dropped || !length) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_insert() called %s\n",
+                length ? "on a hash without keys" : "with a zero-length key"
+            );
+#endif /* HASH_NO_WARNINGS */
+        return false;
     }
 
-    assert(sum >= 0);
+    if (hash_lookup(hash, key, length)) {
+        return false;
+    }
 
-    sum = sum % hash_function->n;
+    hash_overflow_add(&hash->overflow, key, length, ptr);
 
-    return sum;
+    if (hash->overflow.keys.n_inputs >= hash->overflow.rebuild_at &&
+            !hash_rebuild(hash)) {
+        /* try again once there are twice as many */
+        hash->overflow.rebuild_at *= 2;
+    }
+
+    return true;
+}
+
+/* fill statistics with statistics on this hash
+ * these statistics will only be accurate if hash.c was compiled with
+ * -DHASH_STATISTICS
+ */
+void hash_get_statistics(
+        struct hash * hash,
+        struct hash_statistics * statistics
+    ) [[gnu::nonnull(1, 2)]]
+{
+#ifdef HASH_STATISTICS
+    *statistics = hash->statistics;
+#else
+    (void)hash;
+    *statistics = (struct hash_statistics) { };
+#endif /* HASH_STATISTICS */
+}
+
+/* fill options with the options this hash was made with (for a hash from
+ * hash_load_mmap(), the ones it was saved with, as far as they matter to it),
+ * with every field that was 0 for its default set to the value that was used
+ */
+void hash_get_options(
+        const struct hash * hash,
+        struct hash_create_options * options
+    ) [[gnu::nonnull(1, 2)]]
+{
+    *options = hash->options;
 }
 
 /*
- * THE HASH TABLE
+ * SAVING AND LOADING
  */
 
-/* calculate a hash table for all the elements in hash_inputs
- *
- * this can fail. if it does, this function returns null.
- *
- * the tuning parameters in src/hash.c can be adjusted if necessary to change
- * how the parameter-space is searched before giving up.
- *
- * calculation depends on the rand() function for randomness and so affects
- * that state and can be affected by seeding with srand(). it does not call
- * srand().
+/* every file hash_save writes starts with this (followed by "HASHCHM\0") */
+static const char hash_file_magic[8] = "HASHCHM";
+
+/* the version of the format hash_save writes and hash_load_mmap reads */
+constexpr uint32_t hash_file_version = 1;
+
+/* written as-is, so a file from a machine with the other byte order reads
+ * back as 0x04030201
+ */
+constexpr uint32_t hash_file_byte_order = 0x01020304;
+
+/* every section of the file starts at a multiple of this */
+constexpr size_t hash_file_alignment = 64;
+
+/* where a section is in the file, in bytes from the start */
+struct hash_file_section {
+    uint64_t offset;
+    uint64_t size;
+};
+
+/* the start of a file written by hash_save
  *
- * if this returns non-null, the keys will have been removed from hash_inputs.
- * it still needs to be free'd.
+ * the sections are exactly the arrays a hash keeps, so hash_load_mmap can use
+ * them where they are: the salt of each function, the values, the tags (if
+ * any), the key slots, the key bytes their offsets point into, and the ptr of
+ * each key as an integer. everything is in the byte order of the machine that
+ * wrote it. a hash made with drop_keys has empty key slots, key bytes, and
+ * ptrs, and keys_stored 0.
+ */
+struct hash_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    uint64_t n_keys;
+    uint64_t n_values;
+    uint32_t mode;
+    uint32_t values_bits;
+    uint32_t values_packed;
+    uint32_t tag_bits;
+    uint32_t keys_stored;
+    uint32_t padding; /* always 0 */
+    uint64_t fingerprint_seed;
+    uint64_t salt_length;
+    uint64_t function_offset[2];
+    uint64_t function_n[2];
+    uint64_t function_seed[2];
+    struct hash_file_section salt[2];
+    struct hash_file_section values;
+    struct hash_file_section tags;
+    struct hash_file_section slots;
+    struct hash_file_section key_bytes;
+    struct hash_file_section payloads;
+};
+
+/* lay out a section of size bytes at *position, moving *position past it */
+static struct hash_file_section hash_file_place(
+        uint64_t * position, uint64_t size) [[gnu::nonnull(1)]]
+{
+    struct hash_file_section section = {
+        .offset = (*position + hash_file_alignment - 1) /
+            hash_file_alignment * hash_file_alignment,
+        .size = size
+    };
+    *position = section.offset + size;
+    return section;
+}
+
+/* write size bytes of data to file at section.offset, padding from
+ * *position. returns false if the write fails.
+ */
+static bool hash_file_write(
+        FILE * file,
+        uint64_t * position,
+        struct hash_file_section section,
+        const void * data
+    ) [[gnu::nonnull(1, 2)]]
+{
+    assert(section.offset >= *position);
+    assert(section.offset - *position < hash_file_alignment);
+
+    for (uint64_t i = *position; i < section.offset; i++) {
+        if (fputc('\0', file) == EOF) {
+            return false;
+        }
+    }
+    if (section.size && fwrite(data, 1, section.size, file) != section.size) {
+        return false;
+    }
+    *position = section.offset + section.size;
+    return true;
+}
+
+/* write this hash to a file at path, which hash_load_mmap can load again
  *
- * if you want the inputs back, see hash_recycle_inputs, hash_get_inputs, and
- * hash_inputs_from_hash.
+ * returns false (and if not HASH_NO_WARNINGS, prints why) if it can't
  */
-[[nodiscard]] struct hash * hash_create(
-        struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]]
+bool hash_save(
+        const struct hash * hash, const char * path) [[gnu::nonnull(1, 2)]]
 {
-#ifdef HASH_SIMULATE_WORST_CASE
-    size_t n_okay = 0;
-#endif /* HASH_SIMULATE_WORST_CASE */
+    if (hash->overflow.keys.n_inputs) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_save() called on a hash with inserted keys "
+                "(call hash_rebuild() first)\n"
+            );
+#endif /* HASH_NO_WARNINGS */
+        return false;
+    }
 
-    size_t n_keys = hash_inputs->n_inputs;
+    size_t n_keys = hash->keys.n_inputs;
+    size_t n_stored = hash->keys_dropped ? 0 : n_keys;
+
+    struct hash_file_header header = {
+        .version = hash_file_version,
+        .byte_order = hash_file_byte_order,
+        .n_keys = n_keys,
+        .n_values = hash->n_values,
+        .mode = hash->mode,
+        .values_bits = hash->values_bits,
+        .values_packed = hash->values_packed,
+        .tag_bits = hash->tag_bits,
+        .keys_stored = !hash->keys_dropped,
+        .fingerprint_seed = hash->keys.fingerprint_seed,
+        .salt_length = hash->f1.salt_length,
+        .function_offset = { hash->f1.offset, hash->f2.offset },
+        .function_n = { hash->f1.n, hash->f2.n },
+        .function_seed = { hash->f1.seed, hash->f2.seed }
+    };
+    memcpy(header.magic, hash_file_magic, sizeof(header.magic));
 
-    if (n_keys == 0) {
-        return NULL;
+    uint64_t position = sizeof(header);
+    for (size_t i = 0; i < 2; i++) {
+        header.salt[i] = hash_file_place(
+                &position, sizeof(*hash->f1.salt) * hash->f1.salt_length);
+    }
+    header.values = hash_file_place(
+            &position,
+            hash_values_size(
+                hash->n_values, hash->values_bits, hash->values_packed)
+        );
+    header.tags = hash_file_place(&position, hash->tag_bits / 8 * n_keys);
+    header.slots = hash_file_place(
+            &position, sizeof(*hash->key_slots) * n_stored);
+    header.key_bytes = hash_file_place(&position, hash->key_bytes_size);
+    header.payloads = hash_file_place(&position, sizeof(uint64_t) * n_stored);
+    header.file_size = position;
+
+    FILE * file = fopen(path, "wb");
+    if (!file) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_save() couldn't open %s for writing\n",
+                path
+            );
+#endif /* HASH_NO_WARNINGS */
+        return false;
     }
 
-    size_t n_vertices = n_keys + 1;
-    size_t n_vertices_scaled = n_vertices *
-        hash_iterations_growth_multiplier_divider;
+    position = 0;
+    bool ok =
+        hash_file_write(file, &position,
+                (struct hash_file_section) { 0, sizeof(header) }, &header) &&
+        hash_file_write(file, &position, header.salt[0], hash->f1.salt) &&
+        hash_file_write(file, &position, header.salt[1], hash->f2.salt) &&
+        hash_file_write(file, &position, header.values, hash->values) &&
+        hash_file_write(file, &position, header.tags, hash->tags) &&
+        hash_file_write(file, &position, header.slots, hash->key_slots) &&
+        hash_file_write(file, &position, header.key_bytes, hash->key_bytes);
+
+    /* the payloads are the only thing that isn't already an array */
+    if (ok) {
+        ok = hash_file_write(
+                file, &position,
+                (struct hash_file_section) { header.payloads.offset, 0 },
+                NULL);
+    }
+    for (size_t i = 0; ok && i < n_stored; i++) {
+        uint64_t payload = hash->payloads ? hash->payloads[i] :
+            (uint64_t)(uintptr_t)hash->keys.inputs[i].ptr;
+        ok = fwrite(&payload, sizeof(payload), 1, file) == 1;
+    }
 
-    struct graph * graph = graph_create();
-    graph_at_least(graph, n_vertices);
+    if (fclose(file) != 0) {
+        ok = false;
+    }
 
-#ifdef HASH_STATISTICS
-    graph->statistics.graph_size = n_vertices;
-    graph->statistics.total_memory_allocated +=
-        sizeof(*graph) - sizeof(struct hash_statistics);
-    graph->statistics.net_memory_allocated +=
-        sizeof(*graph) - sizeof(struct hash_statistics);
-#endif /* HASH_STATISTICS */
+#if !defined(HASH_NO_WARNINGS)
+    if (!ok) {
+        fprintf(stderr, "WARNING: hash_save() couldn't write %s\n", path);
+    }
+#endif /* HASH_NO_WARNINGS */
+
+    return ok;
+}
+
+/* returns true if section lies inside a file of file_size bytes, at an
+ * aligned offset, and is size bytes long
+ */
+static bool hash_file_section_valid(
+        struct hash_file_section section, uint64_t size, uint64_t file_size)
+{
+    return section.size == size &&
+        section.offset % hash_file_alignment == 0 &&
+        section.offset <= file_size &&
+        section.size <= file_size - section.offset;
+}
 
-    struct hash_function f1 = {}, f2 = {};
+/* returns NULL if this header (of a file of file_size bytes) describes a hash
+ * hash_load_mmap can use, or a description of what's wrong with it otherwise
+ */
+static const char * hash_file_check(
+        const struct hash_file_header * header,
+        uint64_t file_size
+    ) [[gnu::nonnull(1)]]
+{
+    if (memcmp(header->magic, hash_file_magic, sizeof(header->magic))) {
+        return "not a hash file";
+    }
+    if (header->byte_order != hash_file_byte_order) {
+        return "written by a machine with a different byte order";
+    }
+    if (header->version != hash_file_version) {
+        return "unsupported version";
+    }
+    if (header->file_size != file_size) {
+        return "wrong size";
+    }
 
-    size_t iteration = 0;
-    size_t vertices_max = hash_iterations_max_multiplier * n_vertices;
+    uint64_t n_keys = header->n_keys;
+    uint64_t n_values = header->n_values;
+    const uint64_t * offset = header->function_offset;
+    const uint64_t * n = header->function_n;
+    bool split = offset[1] == n[0] && offset[1] + n[1] == n_values;
+    bool shared = offset[1] == 0 && n[0] == n_values && n[1] == n_values;
+    if (n_keys == 0 || n_keys > n_values || n_values >= graph_index_none ||
+            offset[0] != 0 || n[0] == 0 || n[1] == 0 || !(split || shared)) {
+        return "bad graph size";
+    }
+    if (header->mode != HASH_CREATE_SALTED &&
+            header->mode != HASH_CREATE_FINGERPRINT) {
+        return "unknown mode";
+    }
+    if (header->values_packed ?
+            header->values_bits < 1 || header->values_bits > 32 :
+            header->values_bits != 16 && header->values_bits != 32) {
+        return "bad value width";
+    }
+    if (header->tag_bits != 0 && header->tag_bits != 8 &&
+            header->tag_bits != 16 && header->tag_bits != 32) {
+        return "bad tag width";
+    }
+    if (header->salt_length > file_size) {
+        return "bad salt length";
+    }
+    if (header->keys_stored > 1 || header->padding != 0) {
+        return "bad flags";
+    }
+    if (!header->keys_stored && header->key_bytes.size != 0) {
+        return "key bytes without keys";
+    }
 
-    do {
-        if (iteration % hash_iterations_grow_every_n_trials == 0) {
-            if (iteration > 0) {
-                // time to grow the size of the graph
-                n_vertices_scaled *= hash_iterations_growth_multiplier;
-                n_vertices_scaled /= hash_iterations_growth_multiplier_divider;
+    uint64_t n_stored = header->keys_stored ? n_keys : 0;
+
+    uint64_t salt_size = sizeof(uint32_t) * header->salt_length;
+    if (!hash_file_section_valid(header->salt[0], salt_size, file_size) ||
+            !hash_file_section_valid(header->salt[1], salt_size, file_size) ||
+            !hash_file_section_valid(
+                header->values,
+                hash_values_size(
+                    n_values, header->values_bits, header->values_packed),
+                file_size) ||
+            !hash_file_section_valid(
+                header->tags, header->tag_bits / 8 * n_keys, file_size) ||
+            !hash_file_section_valid(
+                header->slots,
+                sizeof(struct hash_key_slot) * n_stored,
+                file_size) ||
+            !hash_file_section_valid(
+                header->key_bytes, header->key_bytes.size, file_size) ||
+            !hash_file_section_valid(
+                header->payloads, sizeof(uint64_t) * n_stored, file_size)) {
+        return "bad section";
+    }
 
-                size_t n_vertices_next =
-                    n_vertices_scaled /
-                    hash_iterations_growth_multiplier_divider;
+    return NULL;
+}
 
-                if (n_vertices_next > n_vertices) {
-                    n_vertices = n_vertices_next;
+/* load a hash written by hash_save from the file at path, mapping it rather
+ * than reading it
+ *
+ * returns NULL (and if not HASH_NO_WARNINGS, prints why) if it can't
+ */
+[[nodiscard]] struct hash * hash_load_mmap(
+        const char * path) [[gnu::nonnull(1)]]
+{
+    const char * error = NULL;
+    unsigned char * mapping = NULL;
+    size_t size = 0;
+
+#if defined(_WIN32)
+    /* no mmap, so read the whole thing instead */
+    FILE * file = fopen(path, "rb");
+    if (!file) {
+        error = "couldn't open it";
+    } else {
+        if (fseek(file, 0, SEEK_END) == 0) {
+            long end = ftell(file);
+            if (end > 0 && fseek(file, 0, SEEK_SET) == 0) {
+                size = end;
+                mapping = malloc(size);
+                if (fread(mapping, 1, size, file) != size) {
+                    free(mapping);
+                    mapping = NULL;
                 }
+            }
+        }
+        fclose(file);
+        if (!mapping) {
+            error = "couldn't read it";
+        }
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0) {
+        error = "couldn't open it";
+    } else {
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            error = "couldn't stat it";
+        } else {
+            size = st.st_size;
+            mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapping == MAP_FAILED) {
+                mapping = NULL;
+                error = "couldn't map it";
+            }
+        }
+        close(fd);
+    }
+#endif /* _WIN32 */
+
+    const struct hash_file_header * header =
+        (const struct hash_file_header *)mapping;
+    if (!error) {
+        if (size < sizeof(*header)) {
+            error = "too short";
+        } else {
+            error = hash_file_check(header, size);
+        }
+    }
 
-                if (n_vertices >= vertices_max) {
+    if (error) {
 #if !defined(HASH_NO_WARNINGS)
-                    fprintf(
-                            stderr,
-                            "WARNING: hash_create() ran for more than size * hash_iteration_max_multiplier iterations (%zu) without a solution\n",
-                            iteration
-                        );
+        fprintf(
+                stderr,
+                "WARNING: hash_load_mmap() couldn't load %s: %s\n",
+                path,
+                error
+            );
 #endif /* HASH_NO_WARNINGS */
-                    free(f1.salt);
-                    free(f2.salt);
-                    graph_destroy(graph);
-                    return NULL;
-                }
-
-#ifdef HASH_STATISTICS
-                graph->statistics.graph_size = n_vertices;
-#endif /* HASH_STATISTICS */
+        if (mapping) {
+#if defined(_WIN32)
+            free(mapping);
+#else
+            munmap(mapping, size);
+#endif /* _WIN32 */
+        }
+        return NULL;
+    }
 
-                graph_at_least(graph, n_vertices);
-            }
+    size_t n_keys = header->n_keys;
+    bool keys_stored = header->keys_stored;
+    struct hash * hash = malloc(sizeof(*hash));
+    *hash = (struct hash) {
+        .keys = {
+            .inputs = keys_stored ?
+                calloc(n_keys, sizeof(struct hash_input)) : NULL,
+            .n_inputs = n_keys,
+            .capacity = keys_stored ? n_keys : 0,
+            .fingerprint_seed = header->fingerprint_seed
+        },
+        .key_slots = keys_stored ?
+            (const struct hash_key_slot *)(mapping + header->slots.offset) :
+            NULL,
+        .key_bytes = (const char *)(mapping + header->key_bytes.offset),
+        .key_bytes_size = header->key_bytes.size,
+        .mode = header->mode,
+        .f1 = {
+            .salt = (uint32_t *)(mapping + header->salt[0].offset),
+            .salt_length = header->salt_length,
+            .seed = header->function_seed[0],
+            .offset = header->function_offset[0],
+            .n = header->function_n[0]
+        },
+        .f2 = {
+            .salt = (uint32_t *)(mapping + header->salt[1].offset),
+            .salt_length = header->salt_length,
+            .seed = header->function_seed[1],
+            .offset = header->function_offset[1],
+            .n = header->function_n[1]
+        },
+        .values = mapping + header->values.offset,
+        .n_values = header->n_values,
+        .values_bits = header->values_bits,
+        .values_packed = header->values_packed,
+        .tags = header->tag_bits ? mapping + header->tags.offset : NULL,
+        .tag_bits = header->tag_bits,
+        .keys_dropped = !keys_stored,
+        .mapping = mapping,
+        .mapping_size = size,
+        .payloads = keys_stored ?
+            (const uint64_t *)(mapping + header->payloads.offset) : NULL,
+        .options = {
+            .mode = header->mode,
+            .values_layout = header->values_packed ?
+                HASH_VALUES_PACKED : HASH_VALUES_NARROWEST,
+            .tag_bits = header->tag_bits,
+            .drop_keys = !keys_stored
         }
+    };
+    hash->options = hash_create_options_resolve(&hash->options);
+    hash->overflow = hash_overflow_create(
+            n_keys, header->fingerprint_seed, &hash->options);
 
-        assert(iteration + 1 > iteration);
+    return hash;
+}
 
-#ifdef HASH_STATISTICS
-        graph->statistics.iterations++;
-#endif /* HASH_STATISTICS */
+/*
+ * GENERATING C
+ */
 
-        iteration++;
+/* the smallest unsigned type of <stdint.h> that holds max */
+static const char * hash_c_type(uint64_t max)
+{
+    if (max <= UINT8_MAX) {
+        return "uint8_t";
+    } else if (max <= UINT16_MAX) {
+        return "uint16_t";
+    } else if (max <= UINT32_MAX) {
+        return "uint32_t";
+    }
+    return "uint64_t";
+}
 
-        graph_wipe(graph);
+/* returns true if name can start every identifier hash_save_c declares */
+static bool hash_c_name_valid(const char * name) [[gnu::nonnull(1)]]
+{
+    if (!(*name == '_' || (*name >= 'a' && *name <= 'z') ||
+                (*name >= 'A' && *name <= 'Z'))) {
+        return false;
+    }
+    for (const char * c = name; *c; c++) {
+        if (!(*c == '_' || (*c >= 'a' && *c <= 'z') ||
+                    (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9'))) {
+            return false;
+        }
+    }
+    return true;
+}
 
-        hash_function_reset(&f1, n_vertices);
-        hash_function_reset(&f2, n_vertices);
+/* write this key of length to file as the contents of a C string literal
+ *
+ * anything but plain printable ASCII is written as a three digit octal
+ * escape, so the escapes never run into the characters after them (and ?
+ * is escaped so nothing can read as a trigraph)
+ */
+static void hash_c_string(
+        FILE * file, const char * key, size_t length) [[gnu::nonnull(1, 2)]]
+{
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = key[i];
+        if (c == '"' || c == '\\' || c == '?') {
+            fprintf(file, "\\%c", c);
+        } else if (c >= ' ' && c <= '~') {
+            fputc(c, file);
+        } else {
+            fprintf(file, "\\%03o", c);
+        }
+    }
+}
 
-        for (size_t i = 0; i < n_keys; i++) {
-            const char * key = hash_inputs->inputs[i].key;
-            size_t length = hash_inputs->inputs[i].length;
+/* write value as element i of an n element array, eight to a line */
+static void hash_c_element(
+        FILE * file, size_t i, size_t n, uint64_t value) [[gnu::nonnull(1)]]
+{
+    fprintf(file, "%s%" PRIu64 "%s",
+            i % 8 == 0 ? "    " : " ",
+            value,
+            i + 1 == n ? "\n" : i % 8 == 7 ? ",\n" : ",");
+}
 
-#ifdef HASH_STATISTICS
-            if (length > f1.salt_capacity) {
-                graph->statistics.reallocs_salt++;
-                graph->statistics.realloc_amount_salt +=
-                    sizeof(*f1.salt) * length;
-                graph->statistics.net_memory_allocated +=
-                    sizeof(*f1.salt) * length -
-                    sizeof(*f1.salt) * f1.salt_capacity;
-                graph->statistics.total_memory_allocated +=
-                    sizeof(*f1.salt) * length;
-            }
-            if (f1.salt_length < length) {
-                graph->statistics.rand_calls += (length - f1.salt_length);
-            }
-            if (length > f2.salt_capacity) {
-                graph->statistics.reallocs_salt++;
-                graph->statistics.realloc_amount_salt +=
-                    sizeof(*f2.salt) * length;
-                graph->statistics.net_memory_allocated +=
-                    sizeof(*f2.salt) * length -
-                    sizeof(*f2.salt) * f2.salt_capacity;
-                graph->statistics.total_memory_allocated +=
-                    sizeof(*f2.salt) * length;
-            }
-            if (f2.salt_length < length) {
-                graph->statistics.rand_calls += (length - f2.salt_length);
-            }
-            graph->statistics.hashes_calculated += 2;
-#endif /* HASH_STATISTICS */
+/* write C source for this hash to a file at path: static const tables and a
+ * static inline name_lookup() that finds a key in them, for a set of keys
+ * known when the program is built
+ *
+ * returns false (and if not HASH_NO_WARNINGS, prints why) if it can't
+ */
+bool hash_save_c(
+        const struct hash * hash,
+        const char * path,
+        const char * name
+    ) [[gnu::nonnull(1, 2, 3)]]
+{
+    if (!hash_c_name_valid(name)) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_save_c() called with name \"%s\", which is not "
+                "a C identifier\n",
+                name
+            );
+#endif /* HASH_NO_WARNINGS */
+        return false;
+    }
+
+    if (hash->keys_dropped || hash->overflow.keys.n_inputs) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_save_c() called on a hash %s\n",
+                hash->keys_dropped ? "without keys" :
+                    "with inserted keys (call hash_rebuild() first)"
+            );
+#endif /* HASH_NO_WARNINGS */
+        return false;
+    }
 
-            hash_function_result r1 = hash_function_hash(&f1, key, length);
-            hash_function_result r2 = hash_function_hash(&f2, key, length);
+    FILE * file = fopen(path, "w");
+    if (!file) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_save_c() couldn't open %s for writing\n",
+                path
+            );
+#endif /* HASH_NO_WARNINGS */
+        return false;
+    }
 
-            graph_biconnect(graph, r1, r2, i);
-        }
-#ifdef HASH_SIMULATE_WORST_CASE
-        n_okay += graph_resolve(graph) ? 1 : 0;
-    } while (n_okay < vertices_max); /* make it think it's doing work */
-#else
-    } while (!graph_resolve(graph));
-#endif /* HASH_SIMULATE_WORST_CASE */
+    size_t n_keys = hash->keys.n_inputs;
 
-#ifndef NDEBUG
+    /* name_key_bytes holds every key, each followed by its terminator */
+    uint64_t key_bytes_size = 0;
+    uint64_t length_max = 0;
     for (size_t i = 0; i < n_keys; i++) {
-        const char * key = hash_inputs->inputs[i].key;
-        size_t length = hash_inputs->inputs[i].length;
-        hash_function_result r1 = hash_function_hash(&f1, key, length);
-        hash_function_result r2 = hash_function_hash(&f2, key, length);
-        hash_function_result v1 = graph->vertices[r1].value;
-        hash_function_result v2 = graph->vertices[r2].value;
-        hash_function_result v = (v1 + v2) % graph->n_vertices;
-        if (v < 0) {
-            v += graph->n_vertices;
+        key_bytes_size += hash->key_slots[i].length + 1;
+        if (hash->key_slots[i].length > length_max) {
+            length_max = hash->key_slots[i].length;
         }
-        assert((ssize_t)i == v);
     }
-#endif /* NDEBUG */
 
-#ifdef HASH_STATISTICS
-    size_t min_capacity = graph->vertices[0].edge_capacity;
-    size_t max_capacity = graph->vertices[0].edge_capacity;
-    size_t unneeded = 0;
-    for (size_t i = 0; i < graph->n_vertices; i++) {
-        if (graph->vertices[i].edge_capacity < min_capacity) {
-            min_capacity = graph->vertices[i].edge_capacity;
+    fprintf(file,
+            "/* %s: a perfect hash of %zu keys\n"
+            " *\n"
+            " * generated by hash_save_c() (part of hash "
+            "<github.com/rmkrupp/hash>)\n"
+            " *\n"
+            " * %s_lookup(key, length) returns the index of key in "
+            "%s_key_offsets and\n"
+            " * %s_key_lengths, or -1 if it isn't one of the keys. "
+            "key i is\n"
+            " * &%s_key_bytes[%s_key_offsets[i]], null terminated.\n"
+            " */\n"
+            "#ifndef HASH_GENERATED_%s\n"
+            "#define HASH_GENERATED_%s\n"
+            "\n"
+            "#include <stddef.h>\n"
+            "#include <stdint.h>\n"
+            "#include <string.h>\n"
+            "\n",
+            name, n_keys, name, name, name, name, name, name, name);
+
+    if (hash->mode == HASH_CREATE_FINGERPRINT) {
+        /* the fingerprint reads the key a word at a time in the byte order
+         * of whatever runs it, so it only matches the one hash_create_ex
+         * calculated on a machine with the same byte order
+         */
+        const uint32_t byte_order = 1;
+        bool little_endian = *(const unsigned char *)&byte_order == 1;
+        fprintf(file,
+                "#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != %s\n"
+                "#error \"%s was generated for a %s-endian machine\"\n"
+                "#endif\n"
+                "\n",
+                little_endian ? "__ORDER_LITTLE_ENDIAN__" :
+                    "__ORDER_BIG_ENDIAN__",
+                name,
+                little_endian ? "little" : "big");
+    }
+
+    fprintf(file, "enum {\n"
+            "    %s_n_keys = %zu,\n"
+            "    %s_key_length_max = %" PRIu64 "\n"
+            "};\n"
+            "\n",
+            name, n_keys, name, length_max);
+
+    if (hash->mode == HASH_CREATE_SALTED) {
+        const char * salt_type = hash_c_type(
+                hash->f1.n > hash->f2.n ? hash->f1.n : hash->f2.n);
+        size_t salt_length = hash->f1.salt_length;
+        fprintf(file, "static const %s %s_salt1[%zu] = {\n",
+                salt_type, name, salt_length);
+        for (size_t i = 0; i < salt_length; i++) {
+            hash_c_element(file, i, salt_length, hash->f1.salt[i]);
         }
-        if (graph->vertices[i].edge_capacity > max_capacity) {
-            max_capacity = graph->vertices[i].edge_capacity;
+        fprintf(file, "};\n\n");
+        fprintf(file, "static const %s %s_salt2[%zu] = {\n",
+                salt_type, name, salt_length);
+        for (size_t i = 0; i < salt_length; i++) {
+            hash_c_element(file, i, salt_length, hash->f2.salt[i]);
         }
-        assert(graph->vertices[i].n_edges <= graph->vertices[i].edge_capacity);
-        unneeded +=
-            graph->vertices[i].edge_capacity - graph->vertices[i].n_edges_max;
+        fprintf(file, "};\n\n");
+    }
+
+    fprintf(file, "static const %s %s_values[%zu] = {\n",
+            hash_c_type(hash->n_values - 1), name, hash->n_values);
+    for (size_t i = 0; i < hash->n_values; i++) {
+        hash_c_element(file, i, hash->n_values, hash_value(hash, i));
+    }
+    fprintf(file, "};\n\n");
+
+    fprintf(file, "static const %s %s_key_lengths[%zu] = {\n",
+            hash_c_type(length_max), name, n_keys);
+    for (size_t i = 0; i < n_keys; i++) {
+        hash_c_element(file, i, n_keys, hash->key_slots[i].length);
+    }
+    fprintf(file, "};\n\n");
+
+    fprintf(file, "static const %s %s_key_offsets[%zu] = {\n",
+            hash_c_type(key_bytes_size), name, n_keys);
+    uint64_t offset = 0;
+    for (size_t i = 0; i < n_keys; i++) {
+        hash_c_element(file, i, n_keys, offset);
+        offset += hash->key_slots[i].length + 1;
+    }
+    fprintf(file, "};\n\n");
+
+    fprintf(file, "static const char %s_key_bytes[%" PRIu64 "] =\n",
+            name, key_bytes_size);
+    for (size_t i = 0; i < n_keys; i++) {
+        const struct hash_key_slot * slot = &hash->key_slots[i];
+        const char * key = slot->length <= hash_key_slot_inline_max ?
+            slot->bytes : &hash->key_bytes[slot->offset];
+        fprintf(file, "    \"");
+        hash_c_string(file, key, slot->length);
+        fprintf(file, "%s\"%s\n",
+                i + 1 == n_keys ? "" : "\\000",
+                i + 1 == n_keys ? ";" : "");
+    }
+    fprintf(file, "\n");
+
+    if (hash->mode == HASH_CREATE_FINGERPRINT) {
+        fprintf(file,
+                "static inline uint64_t %s_mix(uint64_t x)\n"
+                "{\n"
+                "    x ^= x >> 33;\n"
+                "    x *= 0xff51afd7ed558ccdULL;\n"
+                "    x ^= x >> 33;\n"
+                "    x *= 0xc4ceb9fe1a85ec53ULL;\n"
+                "    x ^= x >> 33;\n"
+                "    return x;\n"
+                "}\n"
+                "\n"
+                "static inline uint64_t %s_fingerprint(\n"
+                "        const char * key, size_t length)\n"
+                "{\n"
+                "    uint64_t h = 0x%016" PRIx64 "ULL ^\n"
+                "        (length * 0x9e3779b97f4a7c15ULL);\n"
+                "    size_t i = 0;\n"
+                "    for (; i + 8 <= length; i += 8) {\n"
+                "        uint64_t word;\n"
+                "        memcpy(&word, &key[i], 8);\n"
+                "        h ^= %s_mix(word);\n"
+                "        h = (h << 27 | h >> 37) * 0x9e3779b97f4a7c15ULL;\n"
+                "    }\n"
+                "    if (i < length) {\n"
+                "        uint64_t word = 0;\n"
+                "        memcpy(&word, &key[i], length - i);\n"
+                "        h ^= %s_mix(word);\n"
+                "        h = (h << 27 | h >> 37) * 0x9e3779b97f4a7c15ULL;\n"
+                "    }\n"
+                "    return %s_mix(h);\n"
+                "}\n"
+                "\n",
+                name, name, hash->keys.fingerprint_seed, name, name, name);
+    }
+
+    fprintf(file,
+            "/* returns the index of this key of length, or -1 if it isn't "
+            "one of the keys */\n"
+            "static inline ptrdiff_t %s_lookup(\n"
+            "        const char * key, size_t length)\n"
+            "{\n",
+            name);
+
+    if (hash->mode == HASH_CREATE_FINGERPRINT) {
+        fprintf(file,
+                "    uint64_t fingerprint = %s_fingerprint(key, length);\n"
+                "    uint64_t x1 = "
+                "%s_mix(fingerprint ^ 0x%016" PRIx64 "ULL);\n"
+                "    uint64_t x2 = "
+                "%s_mix(fingerprint ^ 0x%016" PRIx64 "ULL);\n"
+                "    size_t r1 = %zu + (size_t)(((x1 >> 32) * %zu) >> 32);\n"
+                "    size_t r2 = %zu + (size_t)(((x2 >> 32) * %zu) >> 32);\n",
+                name,
+                name, hash->f1.seed,
+                name, hash->f2.seed,
+                hash->f1.offset, hash->f1.n,
+                hash->f2.offset, hash->f2.n);
+    } else {
+        fprintf(file,
+                "    if (length > %s_key_length_max) {\n"
+                "        return -1;\n"
+                "    }\n"
+                "    uint64_t sum1 = 0;\n"
+                "    uint64_t sum2 = 0;\n"
+                "    for (size_t i = 0; i < length; i++) {\n"
+                "        uint64_t x = (unsigned char)key[i];\n"
+                "        sum1 += x * %s_salt1[i];\n"
+                "        sum2 += x * %s_salt2[i];\n"
+                "    }\n"
+                "    size_t r1 = %zu + sum1 %% %zu;\n"
+                "    size_t r2 = %zu + sum2 %% %zu;\n",
+                name, name, name,
+                hash->f1.offset, hash->f1.n,
+                hash->f2.offset, hash->f2.n);
+    }
+
+    fprintf(file,
+            "    size_t i = ((size_t)%s_values[r1] + %s_values[r2]) %% %zu;\n"
+            "    if (i >= %s_n_keys || %s_key_lengths[i] != length ||\n"
+            "            memcmp(&%s_key_bytes[%s_key_offsets[i]], key, "
+            "length) != 0) {\n"
+            "        return -1;\n"
+            "    }\n"
+            "    return (ptrdiff_t)i;\n"
+            "}\n"
+            "\n"
+            "#endif /* HASH_GENERATED_%s */\n",
+            name, name, hash->n_values,
+            name, name, name, name, name);
+
+    bool ok = !ferror(file);
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+
+#if !defined(HASH_NO_WARNINGS)
+    if (!ok) {
+        fprintf(stderr, "WARNING: hash_save_c() couldn't write %s\n", path);
     }
-    graph->statistics.edge_capacity_min = min_capacity;
-    graph->statistics.edge_capacity_max = max_capacity;
-    graph->statistics.unneeded_edges_allocated = unneeded;
+#endif /* HASH_NO_WARNINGS */
+
+    return ok;
+}
+
+/*
+ * HANDLES
+ */
 
-    graph->statistics.vertex_stack_capacity = graph->vertex_stack_capacity;
+/* a thread reading through a struct hash_handle
+ *
+ * hazard is the hash it is reading, if any. while it is, the hash can't be
+ * destroyed. records are never free'd until the handle is, only marked unused
+ * and handed out again, so a writer can always walk the list.
+ */
+struct hash_reader {
+    struct hash_reader * next;
+    struct hash_handle * handle;
+    const struct hash * _Atomic hazard;
+    atomic_bool in_use;
+};
 
-    assert(f1.salt_length == f2.salt_length);
-    graph->statistics.key_length_max = f1.salt_length;
-    graph->statistics.key_length_max = f1.salt_capacity;
-#endif /* HASH_STATISTICS */
+/* a hash that can be replaced while other threads are reading it */
+struct hash_handle {
+    struct hash * _Atomic current;
+    struct hash_reader * _Atomic readers; /* only ever pushed onto */
 
-    /*
-     * TODO: we could restructure graph so that it keeps all the values in an
-     *       array we could extract here instead of split up over the
-     *       vertices
+    /* hashes that have been replaced but might still be being read (only
+     * touched by the writer)
      */
-    struct hash * hash = malloc(sizeof(*hash));
-    *hash = (struct hash) {
-        .keys = *hash_inputs,
-        .f1 = f1,
-        .f2 = f2,
-        .values = malloc(sizeof(*hash->values) * graph->n_vertices),
-        .n_values = graph->n_vertices
-    };
-
-#ifdef HASH_STATISTICS
-    hash->statistics = graph->statistics;
-#endif /* HASH_STATISTICS */
+    struct hash ** retired;
+    size_t n_retired;
+    size_t retired_capacity;
+};
 
-    *hash_inputs = (struct hash_inputs) { };
+/* create a handle for this hash, which it takes ownership of */
+[[nodiscard]] struct hash_handle * hash_handle_create(
+        struct hash * hash) [[gnu::nonnull(1)]]
+{
+    struct hash_handle * handle = malloc(sizeof(*handle));
+    *handle = (struct hash_handle) { };
+    atomic_init(&handle->current, hash);
+    atomic_init(&handle->readers, NULL);
+    return handle;
+}
 
-    for (size_t i = 0; i < graph->n_vertices; i++) {
-        hash->values[i] = graph->vertices[i].value;
+/* destroy this handle, its hash, and any hashes it replaced
+ *
+ * no reader may be reading through it
+ */
+void hash_handle_destroy(struct hash_handle * handle) [[gnu::nonnull(1)]]
+{
+    hash_destroy(atomic_load(&handle->current));
+    for (size_t i = 0; i < handle->n_retired; i++) {
+        hash_destroy(handle->retired[i]);
     }
+    free(handle->retired);
 
-    graph_destroy(graph);
+    struct hash_reader * reader = atomic_load(&handle->readers);
+    while (reader) {
+        struct hash_reader * next = reader->next;
+        free(reader);
+        reader = next;
+    }
 
-    return hash;
+    free(handle);
 }
 
-/* destroy this hash table */
-void hash_destroy(struct hash * hash) [[gnu::nonnull(1)]]
+/* return a reader for this handle, for one thread to read through
+ *
+ * this reuses the record of a reader that was destroyed if there is one, and
+ * otherwise pushes a new one, so it never waits on other threads
+ */
+[[nodiscard]] struct hash_reader * hash_reader_create(
+        struct hash_handle * handle) [[gnu::nonnull(1)]]
 {
-    free(hash->f1.salt);
-    free(hash->f2.salt);
-    if (hash->keys.inputs) {
-        for (size_t i = 0; i < hash->keys.n_inputs; i++) {
-            free(hash->keys.inputs[i].key);
+    for (struct hash_reader * reader = atomic_load(&handle->readers);
+            reader; reader = reader->next) {
+        bool unused = false;
+        if (!atomic_load_explicit(&reader->in_use, memory_order_relaxed) &&
+                atomic_compare_exchange_strong(
+                    &reader->in_use, &unused, true)) {
+            return reader;
         }
-        free(hash->keys.inputs);
     }
-    free(hash->values);
-    free(hash);
+
+    struct hash_reader * reader = malloc(sizeof(*reader));
+    reader->handle = handle;
+    atomic_init(&reader->hazard, NULL);
+    atomic_init(&reader->in_use, true);
+    reader->next = atomic_load(&handle->readers);
+    while (!atomic_compare_exchange_weak(
+                &handle->readers, &reader->next, reader)) {
+        /* reader->next is now the new head */
+    }
+    return reader;
 }
 
-/* returns the number of keys in this hash */
-size_t hash_n_keys(const struct hash * hash) [[gnu::nonnull(1)]]
+/* give this reader back to its handle (it must not be reading) */
+void hash_reader_destroy(struct hash_reader * reader) [[gnu::nonnull(1)]]
 {
-    return hash->keys.n_inputs;
+    assert(!atomic_load(&reader->hazard));
+    atomic_store_explicit(&reader->in_use, false, memory_order_release);
 }
 
-/* destroy this hash table, but extract the hash_inputs it was created with
- * first and return it for modification and reuse
+/* start reading the current hash of this reader's handle, and return it
  *
- * this is a new hash_inputs and needs to be free'd separely from the one
- * passed to hash_create. moreover, free'ing that hash_inputs has no effect
- * on the use or results of this function
+ * the hash stays valid until hash_reader_exit, however many times it's
+ * replaced in the meantime. this never waits on a writer: it only has to try
+ * again if the hash is replaced between loading it and marking it.
  */
-struct hash_inputs * hash_recycle_inputs(
-        struct hash * hash) [[gnu::nonnull(1)]]
+const struct hash * hash_reader_enter(
+        struct hash_reader * reader) [[gnu::nonnull(1)]]
 {
-    struct hash_inputs * inputs = hash_inputs_create();
-    *inputs = hash->keys;
-    hash->keys.inputs = NULL;
-    hash_destroy(hash);
-    return inputs;
+    struct hash_handle * handle = reader->handle;
+    const struct hash * hash = atomic_load(&handle->current);
+    for (;;) {
+        atomic_store(&reader->hazard, hash);
+        const struct hash * again = atomic_load(&handle->current);
+        if (again == hash) {
+            return hash;
+        }
+        hash = again;
+    }
 }
 
-/* returns a pointer to the keys inside this hash table and, if n_keys_out
- * is non-NULL, sets it to the number of keys
- */
-const struct hash_lookup_result * hash_get_keys(
-        const struct hash * hash, size_t * n_keys_out) [[gnu::nonnull(1)]]
+/* stop reading the hash returned by hash_reader_enter */
+void hash_reader_exit(struct hash_reader * reader) [[gnu::nonnull(1)]]
 {
-    if (n_keys_out) {
-        *n_keys_out = hash->keys.n_inputs;
-    }
-    return (struct hash_lookup_result *)hash->keys.inputs;
+    atomic_store_explicit(&reader->hazard, NULL, memory_order_release);
 }
 
-/* apply this function over every key this hash was created with */
-void hash_apply(
-        const struct hash * hash,
-        void (*fn)(
-            const char * key, size_t length, void * data, void * ptr),
-        void * ptr
-    ) [[gnu::nonnull(1, 2)]]
+/* destroy every retired hash of this handle that no reader is reading, and
+ * return how many are left
+ */
+size_t hash_handle_reclaim(struct hash_handle * handle) [[gnu::nonnull(1)]]
 {
-    hash_inputs_apply(&hash->keys, fn, ptr);
+    size_t kept = 0;
+    for (size_t i = 0; i < handle->n_retired; i++) {
+        struct hash * hash = handle->retired[i];
+        bool in_use = false;
+        for (struct hash_reader * reader = atomic_load(&handle->readers);
+                reader && !in_use; reader = reader->next) {
+            in_use = atomic_load(&reader->hazard) == hash;
+        }
+        if (in_use) {
+            handle->retired[kept++] = hash;
+        } else {
+            hash_destroy(hash);
+        }
+    }
+    handle->n_retired = kept;
+    return kept;
 }
 
-/* look up this key of length n in this hash and return a const pointer to the
- * result if found or NULL otherwise
+/* make this hash (which the handle takes ownership of) the one readers get
+ * from now on, and retire the one it replaces
  */
-const struct hash_lookup_result * hash_lookup(
-        const struct hash * hash,
-        const char * key,
-        size_t length
+void hash_handle_publish(
+        struct hash_handle * handle,
+        struct hash * hash
     ) [[gnu::nonnull(1, 2)]]
 {
-    assert(hash->f1.n == hash->n_values);
-    assert(hash->f2.n == hash->n_values);
-    assert(hash->f1.salt_length == hash->f2.salt_length);
-
-    if (length > hash->f1.salt_length) {
-        return NULL;
+    struct hash * old = atomic_exchange(&handle->current, hash);
+
+    if (handle->n_retired == handle->retired_capacity) {
+        handle->retired_capacity = handle->retired_capacity ?
+            handle->retired_capacity * 2 : 4;
+        handle->retired = realloc(
+                handle->retired,
+                sizeof(*handle->retired) * handle->retired_capacity
+            );
     }
+    handle->retired[handle->n_retired++] = old;
 
-    hash_function_result r1 = hash_function_hash_const(&hash->f1, key, length);
-    hash_function_result r2 = hash_function_hash_const(&hash->f2, key, length);
-    hash_function_result i = hash->values[r1] + hash->values[r2];
+    hash_handle_reclaim(handle);
+}
 
-    assert(i >= 0);
-    i = i % hash->n_values;
+/* build a new hash from the keys of this handle's hash plus the keys of
+ * delta, with the options the hash was made with, and publish it
+ *
+ * keys of delta that are already in the hash are skipped, as are repeats
+ * within delta (the first of them is the one added). delta is left as
+ * it was. readers keep reading the old hash the whole time.
+ *
+ * returns false (and if not HASH_NO_WARNINGS, prints why) if it can't, in
+ * which case nothing is published
+ */
+bool hash_handle_update(
+        struct hash_handle * handle,
+        const struct hash_inputs * delta
+    ) [[gnu::nonnull(1)]]
+{
+    /* only the writer replaces it, so it can't go away under us */
+    const struct hash * hash = atomic_load(&handle->current);
 
-    if ((size_t)i >= hash->keys.n_inputs) {
-        return NULL;
+    if (hash->keys_dropped) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_handle_update() called on a hash without keys\n"
+            );
+#endif /* HASH_NO_WARNINGS */
+        return false;
     }
 
-    struct hash_input * input = &hash->keys.inputs[i];
+    /* the keys of delta not in the hash, each once, so the set that finds
+     * repeats only has to hold those
+     */
+    struct hash_inputs * fresh = hash_inputs_create();
+    size_t n_delta = delta ? delta->n_inputs : 0;
+    for (size_t i = 0; i < n_delta; i++) {
+        const struct hash_input * input = &delta->inputs[i];
+        if (!hash_lookup(hash, input->key, input->length)) {
+            hash_inputs_add_safe(fresh, input->key, input->length, input->ptr);
+        }
+    }
 
-    if (input->length != length) {
-        return NULL;
+    struct hash_inputs * inputs =
+        hash_inputs_copy_keys(hash, fresh->n_inputs);
+    for (size_t i = 0; i < fresh->n_inputs; i++) {
+        const struct hash_input * input = &fresh->inputs[i];
+        hash_inputs_add(inputs, input->key, input->length, input->ptr);
     }
+    hash_inputs_destroy(fresh);
 
-    for (size_t i = 0; i < length; i++) {
-        if (input->key[i] != key[i]) {
-            return NULL;
-        }
+#if !defined(HASH_NO_WARNINGS)
+    size_t n_total = inputs->n_inputs;
+#endif /* HASH_NO_WARNINGS */
+    struct hash * replacement = hash_create_ex(inputs, &hash->options);
+    hash_inputs_destroy(inputs);
+
+    if (!replacement) {
+#if !defined(HASH_NO_WARNINGS)
+        fprintf(
+                stderr,
+                "WARNING: hash_handle_update() couldn't create a hash of %zu keys\n",
+                n_total
+            );
+#endif /* HASH_NO_WARNINGS */
+        return false;
     }
 
-    return (const struct hash_lookup_result *)input;
+    hash_handle_publish(handle, replacement);
+    return true;
 }
 
-/* fill statistics with statistics on this hash
- * these statistics will only be accurate if hash.c was compiled with
- * -DHASH_STATISTICS
+/*
+ * HASH INPUTS
  */
-void hash_get_statistics(
-        struct hash * hash,
-        struct hash_statistics * statistics
-    ) [[gnu::nonnull(1, 2)]]
-{
-#ifdef HASH_STATISTICS
-    *statistics = hash->statistics;
-#else
-    (void)hash;
-    *statistics = (struct hash_statistics) { };
-#endif /* HASH_STATISTICS */
-}
 
 /* create an empty hash_inputs structure */
 [[nodiscard]] struct hash_inputs * hash_inputs_create()
@@ -905,18 +4559,30 @@ void hash_get_statistics(
 
 /* create a hash_inputs structure containing all the keys in this hash
  *
- * note that if you are done with the hash, hash_recycles_inputs is more
- * efficient because it recycles the keys in place.
+ * every key is copied, even the ones the hash adopted from
+ * hash_inputs_add_no_copy(), and the hash is left as it was. if you are done
+ * with the hash, hash_recycle_inputs() copies the keys too, but adopts the
+ * adopted keys again and hands over the fingerprints the hash already
+ * computed, so that creating a hash from its result doesn't compute them
+ * again.
  */
 [[nodiscard]] struct hash_inputs * hash_inputs_from_hash(
         struct hash * hash) [[gnu::nonnull(1)]]
 {
     struct hash_inputs * hash_inputs = hash_inputs_create();
-    hash_inputs_grow(hash_inputs, hash->keys.n_inputs);
+    if (hash->keys_dropped) {
+        return hash_inputs;
+    }
+    hash_results_fill(hash);
+    hash_inputs_grow(hash_inputs, hash_n_keys(hash));
     for (size_t i = 0; i < hash->keys.n_inputs; i++) {
-        hash_inputs->inputs[i] = hash->keys.inputs[i];
+        const struct hash_input * input = &hash->keys.inputs[i];
+        hash_inputs_add(hash_inputs, input->key, input->length, input->ptr);
+    }
+    for (size_t i = 0; i < hash->overflow.keys.n_inputs; i++) {
+        const struct hash_input * input = &hash->overflow.keys.inputs[i];
+        hash_inputs_add(hash_inputs, input->key, input->length, input->ptr);
     }
-    hash_inputs->n_inputs = hash->keys.n_inputs;
     return hash_inputs;
 }
 
@@ -931,24 +4597,22 @@ size_t hash_inputs_n_keys(
 void hash_inputs_destroy(
         struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]]
 {
-    for (size_t i = 0; i < hash_inputs->n_inputs; i++) {
-        free(hash_inputs->inputs[i].key);
-    }
+    hash_inputs_free_keys(hash_inputs, true);
     free(hash_inputs->inputs);
     free(hash_inputs);
 }
 
-/* destroy a hash_inputs structure without free'ing its keys
- *
- * use this in conjunction with hash_inputs_add_no_copy()
+/* destroy a hash_inputs structure without free'ing the keys added with
+ * hash_inputs_add_no_copy()
  *
- * if hash_inputs_add() or hash_inputs_add_safe() have been called on this
- * hash_inputs (or if they were called on any of its parents and
- * hash_reycle_inputs() is involved), calling this function will leak memory.
+ * keys copied in by hash_inputs_add() or hash_inputs_add_safe() (including
+ * on any of its parents, if hash_recycle_inputs() is involved) are still
+ * free'd, since they belong to hash_inputs.
  */
 void hash_inputs_destroy_except_keys(
         struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]]
 {
+    hash_inputs_free_keys(hash_inputs, false);
     free(hash_inputs->inputs);
     free(hash_inputs);
 }
@@ -981,18 +4645,41 @@ void hash_inputs_at_least(
     }
 }
 
+/* make sure there's room for n more inputs in hash_inputs, growing it
+ * geometrically if there isn't
+ */
+static void hash_inputs_reserve(
+        struct hash_inputs * hash_inputs, size_t n) [[gnu::nonnull(1)]]
+{
+    assert(hash_inputs->n_inputs <= hash_inputs->capacity);
+
+    size_t needed = hash_inputs->n_inputs + n;
+    if (needed <= hash_inputs->capacity) {
+        return;
+    }
+
+    size_t capacity = hash_inputs->capacity * 2;
+    if (capacity < hash_inputs_grow_min) {
+        capacity = hash_inputs_grow_min;
+    }
+    if (capacity < needed) {
+        capacity = needed;
+    }
+    hash_inputs_grow(hash_inputs, capacity - hash_inputs->capacity);
+}
+
 /* add this key of the given length to this hash_inputs, associating it with
  * ptr
  *
  * a zero-length key cannot be hashed and will be ignored. A warning will
  * be issued unless HASH_NO_WARNINGS
  *
- * this key must not already be in hash_inputs. if it is, the behavior of a
- * hash table generated from these inputs becomes undefined.
+ * this key must not already be in hash_inputs. if it is, hash_create() will
+ * fail (with a warning naming the indices of the two copies, unless
+ * HASH_NO_WARNINGS), usually after only an attempt or two.
  *
- * see hash_inputs_add_safe(), but hash_inputs is not optimized for this case
- * (it does not sort itself) and so hash_inputs_add() is the preferred method
- * of adding keys. sort/deduplicate them beforehand!
+ * if there might be duplicates, see hash_inputs_add_safe(), or add them all
+ * and then call hash_inputs_deduplicate().
  */
 void hash_inputs_add(
         struct hash_inputs * hash_inputs,
@@ -1011,29 +4698,124 @@ void hash_inputs_add(
         return;
     }
 
-    assert(hash_inputs->n_inputs <= hash_inputs->capacity);
-    if (hash_inputs->n_inputs == hash_inputs->capacity) {
-        hash_inputs_grow(hash_inputs, hash_inputs_grow_increment);
-    }
+    hash_inputs_reserve(hash_inputs, 1);
     hash_inputs->inputs[hash_inputs->n_inputs] = (struct hash_input) {
-        .key = malloc(length + 1),
+        .key = hash_inputs_store_key(hash_inputs, key, length),
         .length = length,
         .ptr = ptr
     };
-    for (size_t i = 0; i < length; i++) {
-        hash_inputs->inputs[hash_inputs->n_inputs].key[i] = key[i];
-    }
-    hash_inputs->inputs[hash_inputs->n_inputs].key[length] = '\0';
     hash_inputs->n_inputs++;
 }
 
-/* see hash_inputs_add
+/* returns true if input i of hash_inputs is this key of length */
+static bool hash_inputs_input_is(
+        const struct hash_inputs * hash_inputs,
+        size_t i,
+        const char * key,
+        size_t length
+    ) [[gnu::nonnull(1, 3)]]
+{
+    const struct hash_input * input = &hash_inputs->inputs[i];
+    return input->length == length && !memcmp(input->key, key, length);
+}
+
+/* put input i (which must have its fingerprint) into the set of
+ * hash_inputs_add_safe, which must have room for it
+ */
+static void hash_inputs_unique_place(
+        struct hash_inputs * hash_inputs, size_t i) [[gnu::nonnull(1)]]
+{
+    size_t mask = hash_inputs->n_unique_slots - 1;
+    size_t slot = hash_inputs->fingerprints[i] & mask;
+    while (hash_inputs->unique_slots[slot]) {
+        slot = (slot + 1) & mask;
+    }
+    hash_inputs->unique_slots[slot] = i + 1;
+}
+
+/* make room in the set of hash_inputs_add_safe for n keys, keeping it at
+ * most half full
+ */
+static void hash_inputs_unique_reserve(
+        struct hash_inputs * hash_inputs, size_t n) [[gnu::nonnull(1)]]
+{
+    if (n * 2 <= hash_inputs->n_unique_slots) {
+        return;
+    }
+
+    size_t n_slots = hash_inputs->n_unique_slots ?
+        hash_inputs->n_unique_slots : 16;
+    while (n_slots < n * 2) {
+        n_slots *= 2;
+    }
+
+    free(hash_inputs->unique_slots);
+    hash_inputs->unique_slots =
+        calloc(n_slots, sizeof(*hash_inputs->unique_slots));
+    hash_inputs->n_unique_slots = n_slots;
+
+    for (size_t i = 0; i < hash_inputs->n_unique_inputs; i++) {
+        hash_inputs_unique_place(hash_inputs, i);
+    }
+}
+
+/* the index of this key of length with this fingerprint in the set of
+ * hash_inputs_add_safe, or SIZE_MAX if it isn't there
+ */
+static size_t hash_inputs_unique_find(
+        const struct hash_inputs * hash_inputs,
+        const char * key,
+        size_t length,
+        uint64_t fingerprint
+    ) [[gnu::nonnull(1, 2)]]
+{
+    if (!hash_inputs->n_unique_slots) {
+        return SIZE_MAX;
+    }
+
+    size_t mask = hash_inputs->n_unique_slots - 1;
+    for (size_t slot = fingerprint & mask; ; slot = (slot + 1) & mask) {
+        size_t entry = hash_inputs->unique_slots[slot];
+        if (!entry) {
+            return SIZE_MAX;
+        }
+        if (hash_inputs->fingerprints[entry - 1] == fingerprint &&
+                hash_inputs_input_is(hash_inputs, entry - 1, key, length)) {
+            return entry - 1;
+        }
+    }
+}
+
+/* put the inputs added since the set of hash_inputs_add_safe was last
+ * brought up to date (by hash_inputs_add and the like) into it
  *
- * this lifts the requirement of key uniqueness by comparing this key to every
- * key already in the table. this will not protect future calls to
- * hash_inputs_add() with this key!
+ * those are supposed to be distinct already. any that aren't are left out
+ * of the set, since the copy already in it is enough to catch the next one.
+ */
+static void hash_inputs_unique_update(
+        struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]]
+{
+    hash_inputs_fingerprint(hash_inputs);
+    hash_inputs_unique_reserve(hash_inputs, hash_inputs->n_inputs);
+    for (size_t i = hash_inputs->n_unique_inputs;
+            i < hash_inputs->n_inputs; i++) {
+        const struct hash_input * input = &hash_inputs->inputs[i];
+        if (hash_inputs_unique_find(
+                    hash_inputs, input->key, input->length,
+                    hash_inputs->fingerprints[i]) == SIZE_MAX) {
+            hash_inputs_unique_place(hash_inputs, i);
+        }
+    }
+    hash_inputs->n_unique_inputs = hash_inputs->n_inputs;
+}
+
+/* see hash_inputs_add
  *
- * use mindfully and with caution
+ * this lifts the requirement of key uniqueness by looking the key up in a
+ * set of the keys already in hash_inputs (kept, on their fingerprints, from
+ * one call to the next), so it costs about the same as hash_inputs_add plus
+ * a fingerprint, which is kept for the set and for hash_create. this will
+ * not protect future calls to hash_inputs_add() with this key!
  */
 void hash_inputs_add_safe(
         struct hash_inputs * hash_inputs,
@@ -1048,31 +4830,123 @@ void hash_inputs_add_safe(
                 stderr,
                 "WARNING: hash_inputs_add_safe() was called with a zero-length key\n"
             );
-        return;
 #endif /* HASH_NO_WARNINGS */
+        return;
     }
-    for (size_t i = 0; i < hash_inputs->n_inputs; i++) {
-        if (hash_inputs->inputs[i].length != length) {
-            continue;
-        }
-        bool match = true;
-        for (size_t j = 0; j < length; j++) {
-            if (hash_inputs->inputs[i].key[j] != key[j]) {
-                match = false;
-                break;
-            }
-        }
-        if (match) {
+
+    hash_inputs_unique_update(hash_inputs);
+    uint64_t fingerprint =
+        hash_fingerprint(key, length, hash_inputs->fingerprint_seed);
+    if (hash_inputs_unique_find(
+                hash_inputs, key, length, fingerprint) != SIZE_MAX) {
 #ifdef HASH_STATISTICS
-            hash_inputs->statistics.n_safe_adds_were_unsafe++;
+        hash_inputs->statistics.n_safe_adds_were_unsafe++;
 #endif /* HASH_STATISTICS */
-            return;
-        }
+        return;
     }
 #ifdef HASH_STATISTICS
     hash_inputs->statistics.n_safe_adds_were_safe++;
 #endif /* HASH_STATISTICS */
     hash_inputs_add(hash_inputs, key, length, ptr);
+
+    /* the set was up to date, so only the new key needs to go in it, with
+     * the fingerprint it was looked up with
+     */
+    size_t n_inputs = hash_inputs->n_inputs;
+    hash_inputs_fingerprints_reserve(hash_inputs);
+    hash_inputs->fingerprints[n_inputs - 1] = fingerprint;
+    hash_inputs->n_fingerprints = n_inputs;
+    hash_inputs_unique_reserve(hash_inputs, n_inputs);
+    hash_inputs_unique_place(hash_inputs, n_inputs - 1);
+    hash_inputs->n_unique_inputs = n_inputs;
+}
+
+/* free the keys of hash_inputs_add_no_copy among these n removed keys,
+ * taking them off the list of adopted keys
+ */
+static void hash_inputs_free_removed(
+        struct hash_inputs * hash_inputs,
+        char ** removed,
+        size_t n
+    ) [[gnu::nonnull(1, 2)]]
+{
+    qsort(removed, n, sizeof(*removed), hash_compare_key_pointers);
+
+    size_t n_adopted = 0;
+    for (size_t i = 0; i < hash_inputs->n_adopted_keys; i++) {
+        char * key = hash_inputs->adopted_keys[i];
+        if (bsearch(&key, removed, n, sizeof(*removed),
+                    hash_compare_key_pointers)) {
+            free(key);
+        } else {
+            hash_inputs->adopted_keys[n_adopted++] = key;
+        }
+    }
+    hash_inputs->n_adopted_keys = n_adopted;
+}
+
+/* remove every key from hash_inputs that's the same as one before it,
+ * returning how many were removed
+ *
+ * the first copy of each key (and its ptr) is kept, and the keys keep their
+ * order. this takes one pass over the keys, with a set of them on their
+ * fingerprints, which is kept for hash_inputs_add_safe afterwards.
+ *
+ * keys removed that were added with hash_inputs_add_no_copy() are free'd.
+ */
+size_t hash_inputs_deduplicate(
+        struct hash_inputs * hash_inputs) [[gnu::nonnull(1)]]
+{
+    size_t n_inputs = hash_inputs->n_inputs;
+
+    hash_inputs_fingerprint(hash_inputs);
+
+    /* start the set over, and fill it as the keys are moved down */
+    free(hash_inputs->unique_slots);
+    hash_inputs->unique_slots = NULL;
+    hash_inputs->n_unique_slots = 0;
+    hash_inputs->n_unique_inputs = 0;
+    hash_inputs_unique_reserve(hash_inputs, n_inputs);
+
+    /* only needed if any keys might be adopted ones */
+    char ** removed = NULL;
+    size_t n_removed = 0,
+           removed_capacity = 0;
+
+    size_t n_kept = 0;
+    for (size_t i = 0; i < n_inputs; i++) {
+        struct hash_input input = hash_inputs->inputs[i];
+        uint64_t fingerprint = hash_inputs->fingerprints[i];
+        if (hash_inputs_unique_find(
+                    hash_inputs, input.key, input.length,
+                    fingerprint) != SIZE_MAX) {
+            if (hash_inputs->n_adopted_keys) {
+                if (n_removed == removed_capacity) {
+                    removed_capacity =
+                        removed_capacity ? removed_capacity * 2 : 16;
+                    removed = realloc(
+                            removed, sizeof(*removed) * removed_capacity);
+                }
+                removed[n_removed++] = input.key;
+            }
+            continue;
+        }
+        hash_inputs->inputs[n_kept] = input;
+        hash_inputs->fingerprints[n_kept] = fingerprint;
+        hash_inputs_unique_place(hash_inputs, n_kept);
+        n_kept++;
+    }
+
+    hash_inputs->n_inputs = n_kept;
+    hash_inputs->n_fingerprints = n_kept;
+    hash_inputs->n_unique_inputs = n_kept;
+
+    if (n_removed) {
+        hash_inputs_free_removed(hash_inputs, removed, n_removed);
+    }
+    free(removed);
+
+    return n_inputs - n_kept;
 }
 
 /* see hash_inputs_add
@@ -1104,19 +4978,80 @@ void hash_inputs_add_no_copy(
         return;
     }
 
-    assert(hash_inputs->n_inputs <= hash_inputs->capacity);
-    if (hash_inputs->n_inputs == hash_inputs->capacity) {
-        hash_inputs_grow(hash_inputs, hash_inputs_grow_increment);
-    }
+    hash_inputs_reserve(hash_inputs, 1);
     hash_inputs->inputs[hash_inputs->n_inputs] = (struct hash_input) {
         .key = key,
         .length = length,
         .ptr = ptr
     };
+    hash_inputs_adopt_key(hash_inputs, key);
 
     hash_inputs->n_inputs++;
 }
 
+/* see hash_inputs_add
+ *
+ * add n keys at once, where key i is keys[i] of length lengths[i] and is
+ * associated with ptrs[i] (or NULL, if ptrs is NULL)
+ *
+ * room for all of the keys (and copies of them) is made up front, so this
+ * allocates at most twice no matter how large n is
+ */
+void hash_inputs_add_many(
+        struct hash_inputs * hash_inputs,
+        const char * const * keys,
+        const size_t * lengths,
+        void * const * ptrs,
+        size_t n
+    ) [[gnu::nonnull(1, 2, 3)]]
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        bytes += lengths[i] + 1;
+    }
+
+    hash_inputs_reserve(hash_inputs, n);
+    hash_inputs_reserve_key_bytes(hash_inputs, bytes);
+
+    for (size_t i = 0; i < n; i++) {
+        hash_inputs_add(
+                hash_inputs, keys[i], lengths[i], ptrs ? ptrs[i] : NULL);
+    }
+}
+
+/* see hash_inputs_add
+ *
+ * add n keys at once from one packed buffer, where key i is the bytes from
+ * buffer[offsets[i]] up to (but not including) buffer[offsets[i + 1]], and is
+ * associated with ptrs[i] (or NULL, if ptrs is NULL.) offsets must have n + 1
+ * entries and never decrease.
+ *
+ * like hash_inputs_add_many(), this allocates at most twice
+ */
+void hash_inputs_add_packed(
+        struct hash_inputs * hash_inputs,
+        const char * buffer,
+        const size_t * offsets,
+        void * const * ptrs,
+        size_t n
+    ) [[gnu::nonnull(1, 2, 3)]]
+{
+    assert(offsets[n] >= offsets[0]);
+
+    hash_inputs_reserve(hash_inputs, n);
+    hash_inputs_reserve_key_bytes(hash_inputs, offsets[n] - offsets[0] + n);
+
+    for (size_t i = 0; i < n; i++) {
+        assert(offsets[i + 1] >= offsets[i]);
+        hash_inputs_add(
+                hash_inputs,
+                &buffer[offsets[i]],
+                offsets[i + 1] - offsets[i],
+                ptrs ? ptrs[i] : NULL
+            );
+    }
+}
+
 /* apply this function over every key */
 void hash_inputs_apply(
         const struct hash_inputs * hash_inputs,
@@ -1134,6 +5069,9 @@ void hash_inputs_apply(
 /* apply this function over every key and then destroy the hash inputs
  * (without free'ing the keys, since this is designed to let them escape via
  * the apply)
+ *
+ * keys that live in the key chunks are handed out as malloc'd copies, so that
+ * every key fn sees can be free'd on its own
  */
 void hash_inputs_apply_and_destroy(
         struct hash_inputs * hash_inputs,
@@ -1142,10 +5080,28 @@ void hash_inputs_apply_and_destroy(
         void * ptr
     ) [[gnu::nonnull(1, 2)]]
 {
+    /* sorted (in place, since they're about to go), so an adopted key can be
+     * told apart in log time
+     */
+    char ** adopted = hash_inputs->adopted_keys;
+    size_t n_adopted = hash_inputs->n_adopted_keys;
+    if (n_adopted) {
+        qsort(adopted, n_adopted, sizeof(*adopted),
+                hash_compare_key_pointers);
+    }
+
     for (size_t i = 0; i < hash_inputs->n_inputs; i++) {
         struct hash_input * input = &hash_inputs->inputs[i];
-        fn(input->key, input->length, input->ptr, ptr);
+        char * key = input->key;
+        if (!n_adopted || !bsearch(
+                    &key, adopted, n_adopted, sizeof(*adopted),
+                    hash_compare_key_pointers)) {
+            key = malloc(input->length + 1);
+            memcpy(key, input->key, input->length + 1);
+        }
+        fn(key, input->length, input->ptr, ptr);
     }
+    hash_inputs_free_keys(hash_inputs, false);
     free(hash_inputs->inputs);
     free(hash_inputs);
 }
@@ -0,0 +1,174 @@
+/* File: src/test/batch_test.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* batch_test: hash_lookup_batch() against hash_lookup() one key at a time,
+ * for batches of keys that are in the hash and keys that aren't, mixed
+ * together, of lengths that are and aren't whole groups
+ */
+#include "hash.h"
+#include "test_keys.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+constexpr size_t n_keys = 5000;
+constexpr size_t n_inserted = 300;
+
+/* the keys looked up: every key the hash can have, and as many more */
+constexpr size_t n_looked_up = (n_keys + n_inserted) * 2;
+
+/* look the keys up in batches of n (or, if n is 0, make one empty batch),
+ * comparing every result with hash_lookup()'s, and returning how many
+ * differed
+ */
+static size_t compare(
+        const struct hash * hash,
+        const char * const * keys,
+        const size_t * lengths,
+        size_t n
+    )
+{
+    /* a result that hash_lookup_batch() should overwrite */
+    const struct hash_lookup_result unset = { };
+    const struct hash_lookup_result ** results =
+        malloc(sizeof(*results) * (n + 1));
+    size_t wrong = 0;
+
+    if (!n) {
+        results[0] = &unset;
+        hash_lookup_batch(hash, keys, lengths, results, 0);
+        wrong = results[0] != &unset;
+        free(results);
+        return wrong;
+    }
+
+    for (size_t first = 0; first < n_looked_up; first += n) {
+        size_t n_batch = first + n > n_looked_up ? n_looked_up - first : n;
+        for (size_t j = 0; j < n_batch; j++) {
+            results[j] = &unset;
+        }
+        hash_lookup_batch(
+                hash, &keys[first], &lengths[first], results, n_batch);
+        for (size_t j = 0; j < n_batch; j++) {
+            if (results[j] !=
+                    hash_lookup(hash, keys[first + j], lengths[first + j])) {
+                wrong++;
+            }
+        }
+    }
+
+    free(results);
+    return wrong;
+}
+
+static bool run(const struct hash_create_options * options, bool insert)
+{
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    test_keys_add(hash_inputs, 0, n_keys);
+    struct hash * hash = hash_create_ex(hash_inputs, options);
+    hash_inputs_destroy(hash_inputs);
+    if (!hash) {
+        printf("  hash is null\n");
+        return false;
+    }
+
+    /* keys from hash_insert() are looked up in the overflow */
+    size_t n = n_keys;
+    if (insert) {
+        char key[test_key_length_max];
+        for (; n < n_keys + n_inserted; n++) {
+            hash_insert(hash, key, test_key(key, n), test_key_ptr(n));
+        }
+    }
+
+    /* the first n_looked_up keys, shuffled, so hits and misses are mixed */
+    char (* storage)[test_key_length_max] =
+        malloc(sizeof(*storage) * n_looked_up);
+    const char ** keys = malloc(sizeof(*keys) * n_looked_up);
+    size_t * lengths = malloc(sizeof(*lengths) * n_looked_up);
+    for (size_t j = 0; j < n_looked_up; j++) {
+        size_t i = j * 7919 % n_looked_up;
+        lengths[j] = test_key(storage[j], i);
+        keys[j] = storage[j];
+    }
+
+    size_t wrong = 0;
+    if (!options->drop_keys) {
+        wrong += test_keys_check(hash, n);
+    }
+
+    const size_t batch_lengths[] = { 0, 1, 7, 16, 17, 33, 1000, n_looked_up };
+    for (size_t b = 0; b < sizeof(batch_lengths) / sizeof(*batch_lengths);
+            b++) {
+        size_t n_wrong = compare(hash, keys, lengths, batch_lengths[b]);
+        if (n_wrong) {
+            printf("  in batches of %zu, %zu results were wrong\n",
+                    batch_lengths[b], n_wrong);
+            wrong += n_wrong;
+        }
+    }
+
+    free(storage);
+    free(keys);
+    free(lengths);
+    hash_destroy(hash);
+
+    return !wrong;
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    int status = 0;
+
+    printf("defaults\n");
+    status |= !run(&(struct hash_create_options) { }, false);
+
+    printf("defaults, with inserted keys\n");
+    status |= !run(&(struct hash_create_options) { }, true);
+
+    printf("fingerprint\n");
+    status |= !run(&(struct hash_create_options) {
+            .mode = HASH_CREATE_FINGERPRINT
+        }, false);
+
+    printf("8 bit tags, packed values, with inserted keys\n");
+    status |= !run(&(struct hash_create_options) {
+            .tag_bits = 8,
+            .values_layout = HASH_VALUES_PACKED
+        }, true);
+
+    printf("fingerprint, 16 bit tags\n");
+    status |= !run(&(struct hash_create_options) {
+            .mode = HASH_CREATE_FINGERPRINT,
+            .tag_bits = 16
+        }, false);
+
+    printf("32 bit tags, dropped keys\n");
+    status |= !run(&(struct hash_create_options) {
+            .tag_bits = 32,
+            .drop_keys = true
+        }, false);
+
+    printf(status ? "FAILED\n" : "passed\n");
+    return status;
+}
@@ -0,0 +1,159 @@
+/* File: src/test/builder_test.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* builder_test: one hash_builder used for build after build, of more keys
+ * and then fewer, with different modes and numbers of threads, checking that
+ * each gives the same hash table hash_create_ex() does
+ *
+ * the last builds recycle the keys of the one before and add to them, as
+ * the builder is meant to be used.
+ */
+#include "hash.h"
+#include "test_keys.h"
+
+#include <stdio.h>
+
+/* build a hash of the first n keys with builder, and another with
+ * hash_create_ex(), with these options, and compare them
+ */
+static size_t run(
+        struct hash_builder * builder,
+        size_t n,
+        const struct hash_create_options * options
+    )
+{
+    size_t wrong = 0;
+
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    test_keys_add(hash_inputs, 0, n);
+    struct hash * built = hash_builder_build(builder, hash_inputs, options);
+    hash_inputs_destroy(hash_inputs);
+
+    hash_inputs = hash_inputs_create();
+    test_keys_add(hash_inputs, 0, n);
+    struct hash * created = hash_create_ex(hash_inputs, options);
+    hash_inputs_destroy(hash_inputs);
+
+    if (!built || !created) {
+        printf("  hash is null\n");
+        wrong++;
+    } else {
+        wrong += test_keys_check(built, n);
+        wrong += test_keys_compare(built, created, n);
+    }
+
+    if (built) {
+        hash_destroy(built);
+    }
+    if (created) {
+        hash_destroy(created);
+    }
+    return wrong;
+}
+
+/* build a hash of the first n keys with builder, then recycle its keys, add
+ * the next n_more, and build again, n_rounds times, comparing each build to
+ * hash_create_ex()
+ */
+static size_t run_recycled(
+        struct hash_builder * builder,
+        size_t n,
+        size_t n_more,
+        size_t n_rounds
+    )
+{
+    size_t wrong = 0;
+
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    test_keys_add(hash_inputs, 0, n);
+    for (size_t round = 0; round < n_rounds; round++) {
+        struct hash * built = hash_builder_build(builder, hash_inputs, NULL);
+        hash_inputs_destroy(hash_inputs);
+
+        struct hash_inputs * fresh = hash_inputs_create();
+        test_keys_add(fresh, 0, n);
+        struct hash * created = hash_create(fresh);
+        hash_inputs_destroy(fresh);
+
+        if (!built || !created) {
+            printf("  hash is null\n");
+            if (created) {
+                hash_destroy(created);
+            }
+            if (built) {
+                hash_destroy(built);
+            }
+            return wrong + 1;
+        }
+        wrong += test_keys_check(built, n);
+        wrong += test_keys_compare(built, created, n);
+        hash_destroy(created);
+
+        hash_inputs = hash_recycle_inputs(built);
+        test_keys_add(hash_inputs, n, n + n_more);
+        n += n_more;
+    }
+    hash_inputs_destroy(hash_inputs);
+
+    return wrong;
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    const struct {
+        size_t n;
+        struct hash_create_options options;
+    } builds[] = {
+        { 5000, { } },
+        { 10, { } },
+        { 20000, { .mode = HASH_CREATE_FINGERPRINT, .n_threads = 4 } },
+        { 1, { .mode = HASH_CREATE_FINGERPRINT } },
+        { 3000, { .seed = 7, .n_threads = 8 } },
+        { 40000, { .tag_bits = 16, .seed = 1 } },
+        { 100, { .n_threads = 2 } }
+    };
+
+    struct hash_builder * builder = hash_builder_create();
+    int status = 0;
+
+    for (size_t b = 0; b < sizeof(builds) / sizeof(*builds); b++) {
+        printf("%zu keys\n", builds[b].n);
+        size_t wrong = run(builder, builds[b].n, &builds[b].options);
+        if (wrong) {
+            printf("  %zu checks were wrong\n", wrong);
+            status = 1;
+        }
+    }
+
+    printf("recycled, 2000 keys and 500 more each time\n");
+    size_t wrong = run_recycled(builder, 2000, 500, 8);
+    if (wrong) {
+        printf("  %zu checks were wrong\n", wrong);
+        status = 1;
+    }
+
+    hash_builder_destroy(builder);
+
+    printf(status ? "FAILED\n" : "passed\n");
+    return status;
+}
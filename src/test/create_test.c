@@ -0,0 +1,230 @@
+/* File: src/test/create_test.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* create_test: what hash_create_ex() reports through
+ * hash_create_options.status, for hashes it makes and for ones it can't
+ */
+#include "hash.h"
+#include "test_keys.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+constexpr size_t n_keys = 1000;
+
+/* create a hash of the first n_keys keys, and then key first and key second
+ * again, which should fail naming first and n_keys
+ */
+static bool run_duplicates(
+        enum hash_create_mode mode, size_t first, size_t second)
+{
+    char key[test_key_length_max];
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    test_keys_add(hash_inputs, 0, n_keys);
+    hash_inputs_add(hash_inputs, key, test_key(key, first), NULL);
+    hash_inputs_add(hash_inputs, key, test_key(key, second), NULL);
+
+    struct hash_create_status status;
+    struct hash * hash = hash_create_ex(
+            hash_inputs, &(struct hash_create_options) {
+                .mode = mode,
+                .status = &status
+            });
+    hash_inputs_destroy(hash_inputs);
+
+    if (hash) {
+        printf("  a hash was made anyway\n");
+        hash_destroy(hash);
+        return false;
+    }
+    if (status.outcome != HASH_CREATE_FAILED_DUPLICATE_KEYS) {
+        printf("  the outcome was %d, not HASH_CREATE_FAILED_DUPLICATE_KEYS\n",
+                (int)status.outcome);
+        return false;
+    }
+    if (status.duplicates[0] != first || status.duplicates[1] != n_keys) {
+        printf("  the duplicates were keys %zu and %zu, not %zu and %zu\n",
+                status.duplicates[0], status.duplicates[1], first, n_keys);
+        return false;
+    }
+    if (status.attempts) {
+        printf("  the search made %zu attempts first\n", status.attempts);
+        return false;
+    }
+    return true;
+}
+
+/* create a hash of the first n_keys keys, which should succeed */
+static bool run_succeeds(enum hash_create_mode mode)
+{
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    test_keys_add(hash_inputs, 0, n_keys);
+
+    struct hash_create_status status = {
+        .outcome = HASH_CREATE_FAILED_NO_SOLUTION
+    };
+    struct hash * hash = hash_create_ex(
+            hash_inputs, &(struct hash_create_options) {
+                .mode = mode,
+                .status = &status
+            });
+    hash_inputs_destroy(hash_inputs);
+
+    if (!hash) {
+        printf("  hash is null\n");
+        return false;
+    }
+    size_t wrong = test_keys_check(hash, n_keys);
+    hash_destroy(hash);
+
+    if (status.outcome != HASH_CREATE_SUCCEEDED) {
+        printf("  the outcome was %d, not HASH_CREATE_SUCCEEDED\n",
+                (int)status.outcome);
+        wrong++;
+    }
+    if (!status.attempts) {
+        printf("  the search made no attempts\n");
+        wrong++;
+    }
+    if (wrong) {
+        printf("  %zu checks were wrong\n", wrong);
+    }
+    return !wrong;
+}
+
+/* create hashes of the first n_keys keys with an iterations_max_multiplier
+ * below the starting size, over some seeds, which should each give up or
+ * succeed within the first iterations_grow_every_n_trials attempts
+ */
+static bool run_max_multiplier_below_start()
+{
+    size_t wrong = 0;
+    size_t n_succeeded = 0;
+    for (uint64_t seed = 0; seed < 20; seed++) {
+        struct hash_inputs * hash_inputs = hash_inputs_create();
+        test_keys_add(hash_inputs, 0, n_keys);
+
+        struct hash_create_status status;
+        struct hash * hash = hash_create_ex(
+                hash_inputs, &(struct hash_create_options) {
+                    .seed = seed,
+                    .iterations_max_multiplier = 1,
+                    .iterations_grow_every_n_trials = 3,
+                    .status = &status
+                });
+        hash_inputs_destroy(hash_inputs);
+
+        if (status.attempts < 1 || status.attempts > 3) {
+            printf("  seed %" PRIu64 " made %zu attempts\n",
+                    seed, status.attempts);
+            wrong++;
+        }
+        if (hash) {
+            n_succeeded++;
+            wrong += test_keys_check(hash, n_keys);
+            hash_destroy(hash);
+        } else if (status.outcome != HASH_CREATE_FAILED_NO_SOLUTION) {
+            printf("  seed %" PRIu64 " failed with outcome %d\n",
+                    seed, (int)status.outcome);
+            wrong++;
+        }
+    }
+
+    printf("  %zu of 20 succeeded\n", n_succeeded);
+    if (wrong) {
+        printf("  %zu checks were wrong\n", wrong);
+    }
+    return !wrong;
+}
+
+/* create hashes of 1 to 10 keys over many seeds, in this mode, which
+ * should always succeed even though the graph is only a few vertices
+ */
+static bool run_small(enum hash_create_mode mode)
+{
+    size_t wrong = 0;
+    size_t attempts_max = 0;
+    for (size_t n = 1; n <= 10; n++) {
+        for (uint64_t seed = 0; seed < 1000; seed++) {
+            struct hash_inputs * hash_inputs = hash_inputs_create();
+            test_keys_add(hash_inputs, 0, n);
+
+            struct hash_create_status status;
+            struct hash * hash = hash_create_ex(
+                    hash_inputs, &(struct hash_create_options) {
+                        .mode = mode,
+                        .seed = seed,
+                        .iterations_max_multiplier = 16,
+                        .status = &status
+                    });
+            hash_inputs_destroy(hash_inputs);
+
+            if (!hash) {
+                printf("  %zu keys with seed %" PRIu64 " failed\n",
+                        n, seed);
+                wrong++;
+                continue;
+            }
+            if (status.attempts > attempts_max) {
+                attempts_max = status.attempts;
+            }
+            wrong += test_keys_check(hash, n);
+            hash_destroy(hash);
+        }
+    }
+
+    printf("  at most %zu attempts\n", attempts_max);
+    if (wrong) {
+        printf("  %zu checks were wrong\n", wrong);
+    }
+    return !wrong;
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    int status = 0;
+
+    printf("salted, succeeding\n");
+    status |= !run_succeeds(HASH_CREATE_SALTED);
+
+    printf("fingerprint, succeeding\n");
+    status |= !run_succeeds(HASH_CREATE_FINGERPRINT);
+
+    printf("salted, with keys 500 and 700 added again\n");
+    status |= !run_duplicates(HASH_CREATE_SALTED, 500, 700);
+
+    printf("fingerprint, with keys 0 and 999 added again\n");
+    status |= !run_duplicates(HASH_CREATE_FINGERPRINT, 0, 999);
+
+    printf("salted, 1 to 10 keys, over 1000 seeds\n");
+    status |= !run_small(HASH_CREATE_SALTED);
+
+    printf("fingerprint, 1 to 10 keys, over 1000 seeds\n");
+    status |= !run_small(HASH_CREATE_FINGERPRINT);
+
+    printf("at most 1 vertex per key, over 20 seeds\n");
+    status |= !run_max_multiplier_below_start();
+
+    printf(status ? "FAILED\n" : "passed\n");
+    return status;
+}
@@ -0,0 +1,169 @@
+/* File: src/test/handle_test.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* handle_test: hash_handle_update() while other threads read through
+ * hash_reader_enter()
+ *
+ * the readers look keys up the whole time, checking that every key they
+ * can see has its index and ptr and that a hash never has fewer keys than
+ * the one they saw before it. the writer publishes a new hash again and
+ * again, with deltas that repeat keys already in the hash and keys within
+ * themselves, and checks the keys after each one.
+ */
+#include "hash.h"
+#include "test_keys.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+constexpr size_t n_created = 5000;
+constexpr size_t n_updates = 20;
+constexpr size_t n_per_update = 250;
+constexpr size_t n_readers = 4;
+
+static atomic_bool stop;
+
+struct reader_context {
+    struct hash_handle * handle;
+    size_t wrong;
+    size_t n_reads;
+};
+
+static void * read_keys(void * ptr)
+{
+    struct reader_context * context = ptr;
+    struct hash_reader * reader = hash_reader_create(context->handle);
+    char key[test_key_length_max];
+    size_t n_seen = 0;
+
+    for (size_t j = 0; !atomic_load(&stop); j++) {
+        const struct hash * hash = hash_reader_enter(reader);
+        size_t n = hash_n_keys(hash);
+        if (n < n_seen) {
+            context->wrong++;
+        }
+        n_seen = n;
+        for (size_t k = 0; k < 64; k++) {
+            size_t i = (j * 64 + k) * 7919 % n;
+            size_t length = test_key(key, i);
+            const struct hash_lookup_result * result =
+                hash_lookup(hash, key, length);
+            if (!result || result->ptr != test_key_ptr(i) ||
+                    hash_lookup_index(hash, key, length) != i) {
+                context->wrong++;
+            }
+        }
+        hash_reader_exit(reader);
+        context->n_reads++;
+    }
+
+    hash_reader_destroy(reader);
+    return NULL;
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    char key[test_key_length_max];
+    size_t wrong = 0;
+
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    test_keys_add(hash_inputs, 0, n_created);
+    struct hash * hash = hash_create(hash_inputs);
+    hash_inputs_destroy(hash_inputs);
+    if (!hash) {
+        printf("hash is null\n");
+        return 1;
+    }
+
+    struct hash_handle * handle = hash_handle_create(hash);
+
+    pthread_t threads[n_readers];
+    struct reader_context contexts[n_readers];
+    for (size_t t = 0; t < n_readers; t++) {
+        contexts[t] = (struct reader_context) { .handle = handle };
+        pthread_create(&threads[t], NULL, read_keys, &contexts[t]);
+    }
+
+    /* the writer reads through a reader of its own */
+    struct hash_reader * reader = hash_reader_create(handle);
+
+    size_t n = n_created;
+    for (size_t u = 0; u < n_updates; u++) {
+        struct hash_inputs * delta = hash_inputs_create();
+        for (size_t i = n; i < n + n_per_update; i++) {
+            size_t length = test_key(key, i);
+            hash_inputs_add(delta, key, length, test_key_ptr(i));
+            /* already in the hash */
+            length = test_key(key, i - n_per_update);
+            hash_inputs_add(delta, key, length, NULL);
+            /* earlier in this delta */
+            if (i % 3 == 0) {
+                length = test_key(key, i);
+                hash_inputs_add(delta, key, length, NULL);
+            }
+        }
+
+        if (!hash_handle_update(handle, delta)) {
+            printf("update %zu failed\n", u);
+            wrong++;
+        } else {
+            n += n_per_update;
+        }
+        hash_inputs_destroy(delta);
+
+        wrong += test_keys_check(hash_reader_enter(reader), n);
+        hash_reader_exit(reader);
+    }
+
+    /* a NULL delta rebuilds with the same keys */
+    if (!hash_handle_update(handle, NULL)) {
+        printf("update with no delta failed\n");
+        wrong++;
+    }
+    wrong += test_keys_check(hash_reader_enter(reader), n);
+    hash_reader_exit(reader);
+
+    atomic_store(&stop, true);
+    for (size_t t = 0; t < n_readers; t++) {
+        pthread_join(threads[t], NULL);
+        if (contexts[t].wrong) {
+            printf("reader %zu saw %zu wrong lookups in %zu reads\n",
+                    t, contexts[t].wrong, contexts[t].n_reads);
+            wrong++;
+        }
+    }
+
+    /* nobody is reading, so every replaced hash can go */
+    size_t n_waiting = hash_handle_reclaim(handle);
+    if (n_waiting) {
+        printf("%zu replaced hashes are still waiting\n", n_waiting);
+        wrong++;
+    }
+
+    hash_reader_destroy(reader);
+    hash_handle_destroy(handle);
+
+    printf(wrong ? "FAILED\n" : "passed\n");
+    return wrong ? 1 : 0;
+}
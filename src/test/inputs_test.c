@@ -0,0 +1,169 @@
+/* File: src/test/inputs_test.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* inputs_test: hash_inputs_add_safe() and hash_inputs_deduplicate() with
+ * keys added more than once, checking that the first copy of each key (and
+ * its ptr) is the one kept
+ *
+ * the adopted keys the duplicates of which hash_inputs_deduplicate() frees
+ * are malloc'd here, so a leak or a double free shows up under a sanitizer
+ * (or as a crash.)
+ */
+#include "hash.h"
+#include "test_keys.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+constexpr size_t n_keys = 3000;
+
+/* add key i to hash_inputs with ptr, as a key for it to adopt if adopt */
+static void add(
+        struct hash_inputs * hash_inputs, size_t i, void * ptr, bool adopt)
+{
+    char key[test_key_length_max];
+    size_t length = test_key(key, i);
+    if (adopt) {
+        char * copy = malloc(length);
+        memcpy(copy, key, length);
+        hash_inputs_add_no_copy(hash_inputs, copy, length, ptr);
+    } else {
+        hash_inputs_add(hash_inputs, key, length, ptr);
+    }
+}
+
+/* add key i to hash_inputs with hash_inputs_add_safe() */
+static void add_safe(struct hash_inputs * hash_inputs, size_t i, void * ptr)
+{
+    char key[test_key_length_max];
+    hash_inputs_add_safe(hash_inputs, key, test_key(key, i), ptr);
+}
+
+/* check that hash_inputs has exactly the first n keys, with their ptrs, by
+ * making a hash of them (which destroys hash_inputs)
+ */
+static size_t check(struct hash_inputs * hash_inputs, size_t n)
+{
+    size_t wrong = 0;
+    if (hash_inputs_n_keys(hash_inputs) != n) {
+        printf("  hash_inputs has %zu keys, not %zu\n",
+                hash_inputs_n_keys(hash_inputs), n);
+        wrong++;
+    }
+
+    struct hash * hash = hash_create(hash_inputs);
+    hash_inputs_destroy(hash_inputs);
+    if (!hash) {
+        printf("  hash is null\n");
+        return wrong + 1;
+    }
+    wrong += test_keys_check(hash, n);
+    hash_destroy(hash);
+    return wrong;
+}
+
+/* keys added with hash_inputs_add_safe(), some of them again straight away
+ * and all of them again at the end, along with keys that were added with
+ * hash_inputs_add()
+ */
+static bool run_add_safe()
+{
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    for (size_t i = 0; i < n_keys; i++) {
+        add_safe(hash_inputs, i, test_key_ptr(i));
+        add_safe(hash_inputs, i / 2, NULL);
+        add_safe(hash_inputs, i, NULL);
+    }
+    test_keys_add(hash_inputs, n_keys, n_keys * 2);
+    for (size_t i = 0; i < n_keys * 2; i++) {
+        add_safe(hash_inputs, i, NULL);
+    }
+
+    size_t wrong = check(hash_inputs, n_keys * 2);
+    if (wrong) {
+        printf("  %zu checks were wrong\n", wrong);
+    }
+    return !wrong;
+}
+
+/* keys added with repeats, some of them adopted if adopt, then
+ * deduplicated, and then some more added with hash_inputs_add_safe()
+ */
+static bool run_deduplicate(bool adopt)
+{
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    size_t n_repeats = 0;
+    for (size_t i = 0; i < n_keys; i++) {
+        add(hash_inputs, i, test_key_ptr(i), adopt && i % 2);
+        if (i % 3 == 0) {
+            add(hash_inputs, i / 2, NULL, adopt && i % 4);
+            n_repeats++;
+        }
+        if (i % 5 == 0) {
+            add(hash_inputs, i, NULL, adopt);
+            n_repeats++;
+        }
+    }
+
+    size_t wrong = 0;
+    size_t n_removed = hash_inputs_deduplicate(hash_inputs);
+    if (n_removed != n_repeats) {
+        printf("  %zu keys were removed, not %zu\n", n_removed, n_repeats);
+        wrong++;
+    }
+
+    /* nothing left to remove */
+    if (hash_inputs_deduplicate(hash_inputs)) {
+        printf("  a second hash_inputs_deduplicate() removed keys\n");
+        wrong++;
+    }
+
+    /* the set hash_inputs_add_safe() uses is the one it left */
+    for (size_t i = 0; i < n_keys + 100; i++) {
+        add_safe(hash_inputs, i, i < n_keys ? NULL : test_key_ptr(i));
+    }
+
+    wrong += check(hash_inputs, n_keys + 100);
+    if (wrong) {
+        printf("  %zu checks were wrong\n", wrong);
+    }
+    return !wrong;
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    int status = 0;
+
+    printf("hash_inputs_add_safe\n");
+    status |= !run_add_safe();
+
+    printf("hash_inputs_deduplicate, copied keys\n");
+    status |= !run_deduplicate(false);
+
+    printf("hash_inputs_deduplicate, adopted keys\n");
+    status |= !run_deduplicate(true);
+
+    printf(status ? "FAILED\n" : "passed\n");
+    return status;
+}
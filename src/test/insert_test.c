@@ -0,0 +1,135 @@
+/* File: src/test/insert_test.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* insert_test: hash_insert() past the point where it rebuilds, and
+ * hash_rebuild(), checking that every key keeps its index and ptr
+ */
+#include "hash.h"
+#include "test_keys.h"
+
+#include <stdio.h>
+
+constexpr size_t n_created = 2000;
+constexpr size_t n_inserted = 3000;
+
+/* check that hash_lookup_index_unchecked() finds the first n keys, which it
+ * only does once they've been rebuilt into the hash
+ */
+static size_t check_rebuilt(const struct hash * hash, size_t n)
+{
+    char key[test_key_length_max];
+    size_t wrong = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t length = test_key(key, i);
+        if (hash_lookup_index_unchecked(hash, key, length) != i) {
+            wrong++;
+        }
+    }
+    return wrong;
+}
+
+static bool run(const struct hash_create_options * options)
+{
+    char key[test_key_length_max];
+    size_t wrong = 0;
+
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    test_keys_add(hash_inputs, 0, n_created);
+    struct hash * hash = hash_create_ex(hash_inputs, options);
+    hash_inputs_destroy(hash_inputs);
+    if (!hash) {
+        printf("  hash is null\n");
+        return false;
+    }
+
+    struct hash_create_options used;
+    hash_get_options(hash, &used);
+    size_t rebuild_at = used.overflow_rebuild_min;
+    if (n_created / used.overflow_rebuild_divisor > rebuild_at) {
+        rebuild_at = n_created / used.overflow_rebuild_divisor;
+    }
+
+    for (size_t i = n_created; i < n_created + n_inserted; i++) {
+        size_t length = test_key(key, i);
+        if (!hash_insert(hash, key, length, test_key_ptr(i))) {
+            wrong++;
+        }
+        /* already there, whether from the hash or the overflow */
+        if (hash_insert(hash, key, length, NULL)) {
+            wrong++;
+        }
+        length = test_key(key, i / 2);
+        if (hash_insert(hash, key, length, NULL)) {
+            wrong++;
+        }
+        if ((i + 1) % 250 == 0) {
+            wrong += test_keys_check(hash, i + 1);
+        }
+    }
+    wrong += test_keys_check(hash, n_created + n_inserted);
+
+    /* the inserts that filled the overflow the first time have been rebuilt
+     * into the hash by now
+     */
+    if (n_inserted >= rebuild_at) {
+        wrong += check_rebuilt(hash, n_created + rebuild_at);
+    }
+
+    if (!hash_rebuild(hash)) {
+        printf("  hash_rebuild() failed\n");
+        wrong++;
+    }
+    wrong += test_keys_check(hash, n_created + n_inserted);
+    wrong += check_rebuilt(hash, n_created + n_inserted);
+
+    hash_destroy(hash);
+
+    if (wrong) {
+        printf("  %zu checks were wrong\n", wrong);
+    }
+    return !wrong;
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    int status = 0;
+
+    printf("defaults\n");
+    status |= !run(&(struct hash_create_options) { });
+
+    printf("fingerprint, rebuilding every 64 inserts\n");
+    status |= !run(&(struct hash_create_options) {
+            .mode = HASH_CREATE_FINGERPRINT,
+            .overflow_rebuild_min = 64
+        });
+
+    printf("8 bit tags, packed values, rebuilding every 300 inserts\n");
+    status |= !run(&(struct hash_create_options) {
+            .tag_bits = 8,
+            .values_layout = HASH_VALUES_PACKED,
+            .overflow_rebuild_min = 300
+        });
+
+    printf(status ? "FAILED\n" : "passed\n");
+    return status;
+}
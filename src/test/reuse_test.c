@@ -93,17 +93,14 @@ int main(int argc, char ** argv)
     fprintf(f, "rand_calls = %zu\n", statistics.rand_calls);
     fprintf(f, "hashes_calculated = %zu\n", statistics.hashes_calculated);
     fprintf(f, "graph_size = %zu\n", statistics.graph_size);
+    fprintf(f, "value_bits = %zu\n", statistics.value_bits);
     fprintf(f, "vertex_stack_capacity = %zu\n", statistics.vertex_stack_capacity);
     fprintf(f, "edges_allocated = %zu\n", statistics.edges_allocated);
-    fprintf(f, "edges_preallocated = %zu\n", statistics.edges_preallocated);
-    fprintf(f, "unneeded_edges_allocated = %zu\n",
-            statistics.unneeded_edges_allocated);
-    fprintf(f, "edge_capacity_min = %zu\n", statistics.edge_capacity_min);
-    fprintf(f, "edge_capacity_max = %zu\n", statistics.edge_capacity_max);
+    fprintf(f, "degree_min = %zu\n", statistics.degree_min);
+    fprintf(f, "degree_max = %zu\n", statistics.degree_max);
     fprintf(f, "net_memory_allocated = %zu\n", statistics.net_memory_allocated);
     fprintf(f, "total_memory_allocated = %zu\n",
             statistics.total_memory_allocated);
-    fprintf(f, "reallocs_edges = %zu\n", statistics.reallocs_edges);
     fprintf(f, "reallocs_salt = %zu\n", statistics.reallocs_salt);
     fprintf(f, "reallocs_stack = %zu\n", statistics.reallocs_stack);
     fprintf(f, "reallocs_vertices = %zu\n", statistics.reallocs_vertices);
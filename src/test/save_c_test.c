@@ -0,0 +1,159 @@
+/* File: src/test/save_c_test.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* save_c_test: check that the C source from hash_save_c() compiles and finds
+ * the same indices as hash_lookup_index()
+ *
+ * this is built twice. with SAVE_C_TEST_GENERATE it's the program that
+ * writes the source, a salted and a fingerprint hash of the same keys, to
+ * the two paths it's given. without, it includes what that wrote, builds
+ * the same two hashes again (which, with the same seed, are the same hash
+ * tables), and compares every key and some that aren't keys.
+ */
+#include "hash.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if !defined(SAVE_C_TEST_GENERATE)
+#include "save_c_test_salted.h"
+#include "save_c_test_fingerprint.h"
+#endif /* SAVE_C_TEST_GENERATE */
+
+constexpr size_t n_keys = 5000;
+constexpr size_t n_misses = 5000;
+
+/* write key i (the misses are the ones from n_keys on) to key, returning
+ * its length
+ */
+static size_t make_key(char * key, size_t i)
+{
+    /* the generated code treats short and long keys differently */
+    if (i % 4) {
+        return sprintf(key, "%zx", i * 2654435761u);
+    }
+    return sprintf(key, "a key long enough to take a few words, #%zu", i);
+}
+
+static struct hash * make_hash(enum hash_create_mode mode)
+{
+    char key[64];
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    for (size_t i = 0; i < n_keys; i++) {
+        hash_inputs_add(hash_inputs, key, make_key(key, i), NULL);
+    }
+    struct hash * hash = hash_create_ex(
+            hash_inputs, &(struct hash_create_options) { .mode = mode });
+    hash_inputs_destroy(hash_inputs);
+    return hash;
+}
+
+#if defined(SAVE_C_TEST_GENERATE)
+
+int main(int argc, char ** argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s SALTED_PATH FINGERPRINT_PATH\n", argv[0]);
+        return 1;
+    }
+
+    static const enum hash_create_mode modes[] = {
+        HASH_CREATE_SALTED, HASH_CREATE_FINGERPRINT
+    };
+    static const char * names[] = {
+        "save_c_test_salted", "save_c_test_fingerprint"
+    };
+
+    for (size_t m = 0; m < 2; m++) {
+        struct hash * hash = make_hash(modes[m]);
+        if (!hash) {
+            fprintf(stderr, "%s: hash is null\n", argv[0]);
+            return 1;
+        }
+        bool saved = hash_save_c(hash, argv[m + 1], names[m]);
+        hash_destroy(hash);
+        if (!saved) {
+            fprintf(stderr, "%s: couldn't write %s\n", argv[0], argv[m + 1]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+#else /* SAVE_C_TEST_GENERATE */
+
+typedef ptrdiff_t (*generated_lookup_fn)(const char * key, size_t length);
+
+/* compare the generated lookup against hash_lookup_index for every key and
+ * miss, returning how many differed
+ */
+static size_t check(const struct hash * hash, generated_lookup_fn lookup)
+{
+    char key[64];
+    size_t wrong = 0;
+    for (size_t i = 0; i < n_keys + n_misses; i++) {
+        size_t length = make_key(key, i);
+        size_t index = hash_lookup_index(hash, key, length);
+        ptrdiff_t generated = lookup(key, length);
+        size_t expected = i < n_keys ? i : SIZE_MAX;
+        if (index != expected ||
+                (generated < 0 ? SIZE_MAX : (size_t)generated) != expected) {
+            wrong++;
+        }
+    }
+    return wrong;
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    static const enum hash_create_mode modes[] = {
+        HASH_CREATE_SALTED, HASH_CREATE_FINGERPRINT
+    };
+    static const generated_lookup_fn lookups[] = {
+        save_c_test_salted_lookup, save_c_test_fingerprint_lookup
+    };
+
+    int status = 0;
+    for (size_t m = 0; m < 2; m++) {
+        printf("mode %d\n", modes[m]);
+        struct hash * hash = make_hash(modes[m]);
+        if (!hash) {
+            printf("  hash is null\n");
+            status = 1;
+            continue;
+        }
+        size_t wrong = check(hash, lookups[m]);
+        hash_destroy(hash);
+        if (wrong) {
+            printf("  %zu lookups were wrong\n", wrong);
+            status = 1;
+        }
+    }
+
+    printf(status ? "FAILED\n" : "passed\n");
+    return status;
+}
+
+#endif /* SAVE_C_TEST_GENERATE */
@@ -0,0 +1,185 @@
+/* File: src/test/save_test.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* save_test: round trip hashes through hash_save() and hash_load_mmap()
+ *
+ * for each mode, values layout, and tag width, this saves a hash to
+ * save_test.hash in the current directory, loads it, and checks that every
+ * key is found with its index and ptr and that keys that weren't added
+ * aren't.
+ */
+#include "hash.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+constexpr size_t n_keys = 20000;
+constexpr size_t n_misses = 20000;
+
+static const char * path = "save_test.hash";
+
+/* write key i (the misses are the ones from n_keys on) to key, returning
+ * its length
+ */
+static size_t make_key(char * key, size_t i)
+{
+    /* some short keys and some long ones */
+    if (i % 3) {
+        return sprintf(key, "k%zu", i);
+    }
+    return sprintf(key, "a somewhat longer key, number %zu of them", i);
+}
+
+/* check every key (and miss) of a loaded hash, returning how many were
+ * wrong
+ */
+static size_t check(const struct hash * hash)
+{
+    char key[64];
+    size_t wrong = 0;
+
+    for (size_t i = 0; i < n_keys; i++) {
+        size_t length = make_key(key, i);
+        const struct hash_lookup_result * result =
+            hash_lookup(hash, key, length);
+        if (!result || result->length != length ||
+                memcmp(result->key, key, length) || result->key[length] ||
+                result->ptr != (void *)(uintptr_t)(i + 1)) {
+            wrong++;
+        }
+        if (hash_lookup_index(hash, key, length) != i ||
+                hash_lookup_index_unchecked(hash, key, length) != i) {
+            wrong++;
+        }
+    }
+
+    for (size_t i = n_keys; i < n_keys + n_misses; i++) {
+        size_t length = make_key(key, i);
+        if (hash_lookup(hash, key, length) ||
+                hash_lookup_index(hash, key, length) != SIZE_MAX) {
+            wrong++;
+        }
+    }
+
+    /* and in the order of their indices, which fills every result the
+     * lookups didn't
+     */
+    size_t n;
+    const struct hash_lookup_result * keys = hash_get_keys(hash, &n);
+    if (n != n_keys) {
+        printf("  has %zu keys, not %zu\n", n, n_keys);
+        return wrong + 1;
+    }
+    for (size_t i = 0; i < n_keys; i++) {
+        size_t length = make_key(key, i);
+        if (keys[i].length != length || memcmp(keys[i].key, key, length) ||
+                keys[i].ptr != (void *)(uintptr_t)(i + 1)) {
+            wrong++;
+        }
+    }
+
+    return wrong;
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    static const enum hash_create_mode modes[] = {
+        HASH_CREATE_SALTED, HASH_CREATE_FINGERPRINT
+    };
+    static const enum hash_values_layout layouts[] = {
+        HASH_VALUES_NARROWEST, HASH_VALUES_PACKED
+    };
+    static const unsigned int tag_bits[] = { 0, 8, 16, 32 };
+
+    char key[64];
+    int status = 0;
+
+    for (size_t m = 0; m < 2; m++) {
+        for (size_t l = 0; l < 2; l++) {
+            for (size_t t = 0; t < 4; t++) {
+                struct hash_create_options options = {
+                    .mode = modes[m],
+                    .values_layout = layouts[l],
+                    .tag_bits = tag_bits[t]
+                };
+                printf("mode %d, layout %d, %u tag bits\n",
+                        modes[m], layouts[l], tag_bits[t]);
+
+                struct hash_inputs * hash_inputs = hash_inputs_create();
+                for (size_t i = 0; i < n_keys; i++) {
+                    size_t length = make_key(key, i);
+                    hash_inputs_add(hash_inputs, key, length,
+                            (void *)(uintptr_t)(i + 1));
+                }
+                struct hash * hash = hash_create_ex(hash_inputs, &options);
+                hash_inputs_destroy(hash_inputs);
+                if (!hash) {
+                    printf("  hash is null\n");
+                    status = 1;
+                    continue;
+                }
+
+                bool saved = hash_save(hash, path);
+                hash_destroy(hash);
+                if (!saved) {
+                    printf("  couldn't save\n");
+                    status = 1;
+                    continue;
+                }
+
+                struct hash * loaded = hash_load_mmap(path);
+                remove(path);
+                if (!loaded) {
+                    printf("  couldn't load\n");
+                    status = 1;
+                    continue;
+                }
+
+                size_t wrong = check(loaded);
+                /* again, now that the results have been filled */
+                wrong += check(loaded);
+                hash_destroy(loaded);
+                if (wrong) {
+                    printf("  %zu lookups were wrong\n", wrong);
+                    status = 1;
+                }
+            }
+        }
+    }
+
+    /* something that isn't a hash file */
+    FILE * file = fopen(path, "w");
+    fputs("this is not a hash\n", file);
+    fclose(file);
+    struct hash * hash = hash_load_mmap(path);
+    remove(path);
+    if (hash) {
+        printf("loaded a file that isn't a hash\n");
+        hash_destroy(hash);
+        status = 1;
+    }
+
+    printf(status ? "FAILED\n" : "passed\n");
+    return status;
+}
@@ -0,0 +1,114 @@
+/* File: src/test/test_keys.h
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* the keys the tests that add keys to a hash as they go share: key i is
+ * "key number i", added with (void *)(i + 1) as its ptr, so that its index
+ * should be i
+ */
+#ifndef TEST_KEYS_H
+#define TEST_KEYS_H
+
+#include "hash.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* the longest key test_key writes, with its terminator */
+constexpr size_t test_key_length_max = 32;
+
+/* write key i to key, returning its length */
+static inline size_t test_key(char * key, size_t i)
+{
+    return sprintf(key, "key number %zu", i);
+}
+
+/* the ptr key i is added with */
+static inline void * test_key_ptr(size_t i)
+{
+    return (void *)(uintptr_t)(i + 1);
+}
+
+/* add keys first through last - 1 to hash_inputs */
+static inline void test_keys_add(
+        struct hash_inputs * hash_inputs, size_t first, size_t last)
+{
+    char key[test_key_length_max];
+    for (size_t i = first; i < last; i++) {
+        hash_inputs_add(hash_inputs, key, test_key(key, i), test_key_ptr(i));
+    }
+}
+
+/* check that hash has exactly the first n keys, each found with its index
+ * and ptr, and that the next 100 aren't found, returning how many checks
+ * were wrong
+ */
+static inline size_t test_keys_check(const struct hash * hash, size_t n)
+{
+    char key[test_key_length_max];
+    size_t wrong = 0;
+
+    if (hash_n_keys(hash) != n) {
+        printf("  has %zu keys, not %zu\n", hash_n_keys(hash), n);
+        wrong++;
+    }
+
+    for (size_t i = 0; i < n + 100; i++) {
+        size_t length = test_key(key, i);
+        const struct hash_lookup_result * result =
+            hash_lookup(hash, key, length);
+        size_t index = hash_lookup_index(hash, key, length);
+        if (i < n) {
+            if (!result || result->ptr != test_key_ptr(i) || index != i) {
+                wrong++;
+            }
+        } else if (result || index != SIZE_MAX) {
+            wrong++;
+        }
+    }
+
+    return wrong;
+}
+
+/* compare two hashes of the first n keys, which should be the same hash
+ * table: each key should get the same index from both, and so should the
+ * next 100 (which aren't in them) from hash_lookup_index_unchecked().
+ * returns how many keys didn't.
+ */
+static inline size_t test_keys_compare(
+        const struct hash * a, const struct hash * b, size_t n)
+{
+    char key[test_key_length_max];
+    size_t wrong = 0;
+
+    for (size_t i = 0; i < n + 100; i++) {
+        size_t length = test_key(key, i);
+        if (i < n ?
+                hash_lookup_index(a, key, length) !=
+                    hash_lookup_index(b, key, length) :
+                hash_lookup_index_unchecked(a, key, length) !=
+                    hash_lookup_index_unchecked(b, key, length)) {
+            wrong++;
+        }
+    }
+
+    return wrong;
+}
+
+#endif /* TEST_KEYS_H */
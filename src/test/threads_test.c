@@ -0,0 +1,134 @@
+/* File: src/test/threads_test.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* threads_test: hash_create_ex() with 1, 2, and 8 threads, checking that
+ * each seed gives the same hash table no matter how many threads searched
+ * for it, by comparing the index every key (and some keys that aren't in it)
+ * gets from hash_lookup_index()
+ *
+ * if hash.c was compiled with HASH_NO_THREADS, every build runs on one
+ * thread (with a warning), and the hash tables are still compared.
+ */
+#include "hash.h"
+#include "test_keys.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+static const size_t thread_counts[] = { 1, 2, 8 };
+constexpr size_t n_thread_counts =
+    sizeof(thread_counts) / sizeof(*thread_counts);
+
+/* build a hash of the first n keys with this seed, mode, and number of
+ * threads, checking its keys
+ */
+static struct hash * build(
+        size_t n,
+        uint64_t seed,
+        enum hash_create_mode mode,
+        size_t n_threads,
+        size_t * wrong
+    )
+{
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    test_keys_add(hash_inputs, 0, n);
+    struct hash * hash = hash_create_ex(
+            hash_inputs, &(struct hash_create_options) {
+                .n_threads = n_threads,
+                .mode = mode,
+                .seed = seed
+            });
+    hash_inputs_destroy(hash_inputs);
+
+    if (!hash) {
+        printf("  %zu threads gave no hash\n", n_threads);
+        (*wrong)++;
+        return NULL;
+    }
+    *wrong += test_keys_check(hash, n);
+    return hash;
+}
+
+/* build hashes of the first n keys with this seed and mode on each number of
+ * threads, and compare them
+ */
+static size_t run(size_t n, uint64_t seed, enum hash_create_mode mode)
+{
+    size_t wrong = 0;
+
+    struct hash * hashes[n_thread_counts];
+    for (size_t t = 0; t < n_thread_counts; t++) {
+        hashes[t] = build(n, seed, mode, thread_counts[t], &wrong);
+    }
+
+    if (!wrong) {
+        size_t n_differ = 0;
+        for (size_t t = 1; t < n_thread_counts; t++) {
+            n_differ += test_keys_compare(hashes[0], hashes[t], n);
+        }
+        if (n_differ) {
+            printf("  %zu keys with seed %" PRIu64 " got other indices\n",
+                    n, seed);
+            wrong += n_differ;
+        }
+    }
+
+    for (size_t t = 0; t < n_thread_counts; t++) {
+        if (hashes[t]) {
+            hash_destroy(hashes[t]);
+        }
+    }
+    return wrong;
+}
+
+int main(int argc, char ** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    const size_t key_counts[] = { 1, 10, 1000, 50000 };
+    const struct {
+        const char * name;
+        enum hash_create_mode mode;
+    } modes[] = {
+        { "salted", HASH_CREATE_SALTED },
+        { "fingerprint", HASH_CREATE_FINGERPRINT }
+    };
+
+    int status = 0;
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(*modes); m++) {
+        for (size_t k = 0; k < sizeof(key_counts) / sizeof(*key_counts);
+                k++) {
+            printf("%s, %zu keys\n", modes[m].name, key_counts[k]);
+            size_t wrong = 0;
+            for (uint64_t seed = 0; seed < 4; seed++) {
+                wrong += run(key_counts[k], seed, modes[m].mode);
+            }
+            if (wrong) {
+                printf("  %zu checks were wrong\n", wrong);
+                status = 1;
+            }
+        }
+    }
+
+    printf(status ? "FAILED\n" : "passed\n");
+    return status;
+}
@@ -0,0 +1,162 @@
+/* File: src/tools/hash_generate.c
+ * Part of hash <github.com/rmkrupp/hash>
+ *
+ * Copyright (C) 2024 Noah Santer <n.ed.santer@gmail.com>
+ * Copyright (C) 2024 Rebecca Krupp <beka.krupp@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* hash_generate: make a hash of the keys in a file (one per line) ahead of
+ * time and write it out as C source, with hash_save_c()
+ *
+ * the keys are numbered from 0 in the order they first appear, skipping
+ * empty lines.
+ */
+#include "hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(FILE * file, const char * argv0)
+{
+    fprintf(file,
+            "usage: %s [OPTIONS] NAME [KEYS]\n"
+            "\n"
+            "write a perfect hash of the lines of KEYS (or of standard input,\n"
+            "if there's no KEYS or it's -) to NAME.h as C source, with a\n"
+            "lookup function NAME_lookup()\n"
+            "\n"
+            "  -o PATH      write to PATH instead of NAME.h\n"
+            "  -f           use HASH_CREATE_FINGERPRINT (the default is\n"
+            "               HASH_CREATE_SALTED, which the compiler can fold\n"
+            "               for keys of a known length)\n"
+            "  -s SEED      seed the search with SEED (default 0)\n"
+            "  -t THREADS   search on THREADS threads (default 1)\n"
+            "  -h           print this and exit\n",
+            argv0);
+}
+
+/* read one line of file into *buffer (growing it as needed), without the
+ * newline, returning its length or -1 at the end of the file
+ */
+static long read_line(FILE * file, char ** buffer, size_t * capacity)
+{
+    size_t length = 0;
+    for (;;) {
+        if (length + 1 >= *capacity) {
+            *capacity = *capacity ? *capacity * 2 : 256;
+            *buffer = realloc(*buffer, *capacity);
+        }
+        if (!fgets(*buffer + length, *capacity - length, file)) {
+            return length ? (long)length : -1;
+        }
+        length += strlen(*buffer + length);
+        if (length && (*buffer)[length - 1] == '\n') {
+            (*buffer)[--length] = '\0';
+            return length;
+        }
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    const char * output = NULL;
+    const char * name = NULL;
+    const char * keys_path = NULL;
+    struct hash_create_options options = { };
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-h")) {
+            usage(stdout, argv[0]);
+            return 0;
+        } else if (!strcmp(argv[i], "-f")) {
+            options.mode = HASH_CREATE_FINGERPRINT;
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            output = argv[++i];
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            options.seed = strtoull(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            options.n_threads = strtoul(argv[++i], NULL, 0);
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(stderr, argv[0]);
+            return 1;
+        } else if (!name) {
+            name = argv[i];
+        } else if (!keys_path) {
+            keys_path = argv[i];
+        } else {
+            usage(stderr, argv[0]);
+            return 1;
+        }
+    }
+
+    if (!name) {
+        usage(stderr, argv[0]);
+        return 1;
+    }
+
+    char * default_output = NULL;
+    if (!output) {
+        default_output = malloc(strlen(name) + 3);
+        sprintf(default_output, "%s.h", name);
+        output = default_output;
+    }
+
+    FILE * file = stdin;
+    if (keys_path && strcmp(keys_path, "-")) {
+        file = fopen(keys_path, "r");
+        if (!file) {
+            fprintf(stderr, "%s: couldn't open %s\n", argv[0], keys_path);
+            free(default_output);
+            return 1;
+        }
+    }
+
+    struct hash_inputs * hash_inputs = hash_inputs_create();
+    char * buffer = NULL;
+    size_t capacity = 0;
+    long length;
+    while ((length = read_line(file, &buffer, &capacity)) >= 0) {
+        if (length > 0) {
+            hash_inputs_add_safe(hash_inputs, buffer, length, NULL);
+        }
+    }
+    free(buffer);
+    if (file != stdin) {
+        fclose(file);
+    }
+
+    if (hash_inputs_n_keys(hash_inputs) == 0) {
+        fprintf(stderr, "%s: no keys\n", argv[0]);
+        hash_inputs_destroy(hash_inputs);
+        free(default_output);
+        return 1;
+    }
+
+    struct hash * hash = hash_create_ex(hash_inputs, &options);
+    hash_inputs_destroy(hash_inputs);
+    if (!hash) {
+        fprintf(stderr, "%s: couldn't create a hash of these keys\n", argv[0]);
+        free(default_output);
+        return 1;
+    }
+
+    bool ok = hash_save_c(hash, output, name);
+    hash_destroy(hash);
+    free(default_output);
+
+    return ok ? 0 : 1;
+}